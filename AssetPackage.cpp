@@ -0,0 +1,244 @@
+#include "AssetPackage.hpp"
+#include "BlobWriter.hpp"
+#include "Meshes.hpp"
+#include "Mipmaps.hpp"
+#include "ThreadPool.hpp"
+#include "load_save_png.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+std::vector< std::pair< std::string, std::string > > const &AssetPackage::default_materials() {
+	static std::vector< std::pair< std::string, std::string > > const materials = {
+		{"Balloon1", "balloon1.png"},
+		{"Balloon2", "balloon2.png"},
+		{"Balloon3", "balloon3.png"},
+		{"Stand", "stand.png"},
+		{"Base", "base.png"},
+		{"Link1", "link1.png"},
+		{"Link2", "link2.png"},
+		{"Link3", "link3.png"},
+		{"Crate", "cube.png"}, //(crate.png is invisible, so crates use the cube's texture)
+		{"Cube.001", "cube.png"},
+		{"Crate.001", "cube.png"},
+		{"Crate.002", "cube.png"},
+		{"Crate.003", "cube.png"},
+		{"Crate.004", "cube.png"},
+		{"Crate.005", "cube.png"},
+		{"Balloon1-Pop", "balloon1.png"},
+		{"Balloon2-Pop", "balloon2.png"},
+		{"Balloon3-Pop", "balloon3.png"},
+	};
+	return materials;
+}
+
+std::string AssetPackage::material_fallback(std::string const &name) {
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos) return "";
+	return name.substr(0, dot);
+}
+
+static std::string get_name(BlobSpan< char > const &strings, uint32_t begin, uint32_t end, std::string const &filename) {
+	if (!(begin <= end && end <= strings.size)) {
+		throw std::runtime_error("'" + filename + "' has an entry with out-of-range name begin/end");
+	}
+	return std::string(strings.data + begin, strings.data + end);
+}
+
+AssetPackage::AssetPackage(std::string const &filename) : blob(filename) {
+	blob.verify_pool = &ThreadPool::shared();
+
+	BlobSpan< char > strings = blob.find_chunk< char >("pst0");
+	BlobSpan< TextureEntry > texture_entries = blob.find_chunk< TextureEntry >("tex0");
+	BlobSpan< LevelEntry > level_entries = blob.find_chunk< LevelEntry >("lvl0");
+	BlobSpan< MaterialEntry > material_entries = blob.find_chunk< MaterialEntry >("mtl0");
+	BlobSpan< uint32_t > texels = blob.find_chunk< uint32_t >("txd0");
+
+	for (auto const &entry : texture_entries) {
+		textures.emplace_back();
+		Texture &texture = textures.back();
+		texture.name = get_name(strings, entry.name_begin, entry.name_end, filename);
+		if (!(entry.level_begin < entry.level_end && entry.level_end <= level_entries.size)) {
+			throw std::runtime_error("Texture '" + texture.name + "' in '" + filename + "' has out-of-range levels.");
+		}
+		for (uint32_t l = entry.level_begin; l < entry.level_end; ++l) {
+			LevelEntry const &level = level_entries[l];
+			uint64_t count = uint64_t(level.width) * level.height;
+			if (level.width == 0 || level.height == 0 || level.offset % 4 != 0 || level.offset / 4 > texels.size || texels.size - level.offset / 4 < count) {
+				throw std::runtime_error("Texture '" + texture.name + "' in '" + filename + "' has an out-of-range level.");
+			}
+			texture.levels.emplace_back();
+			texture.levels.back().size = glm::uvec2(level.width, level.height);
+			texture.levels.back().texels = texels.data + level.offset / 4;
+		}
+	}
+
+	for (auto const &entry : material_entries) {
+		std::string name = get_name(strings, entry.name_begin, entry.name_end, filename);
+		if (entry.texture >= textures.size()) {
+			throw std::runtime_error("Material '" + name + "' in '" + filename + "' has an out-of-range texture.");
+		}
+		materials.emplace_back(name, entry.texture);
+	}
+
+	blob.wait_verified();
+}
+
+void AssetPackage::read_scene(MappedBlob &file, std::string const &strings_magic, std::vector< Object > *objects) {
+	BlobSpan< char > strings = file.find_chunk< char >(strings_magic);
+	BlobSpan< SceneEntry > entries = file.find_chunk< SceneEntry >("scn0");
+	BlobSpan< uint32_t > parents;
+	if (file.has_chunk("prn0")) {
+		parents = file.find_chunk< uint32_t >("prn0");
+		if (parents.size != entries.size) {
+			throw std::runtime_error("'" + file.filename + "' has " + std::to_string(parents.size) + " parents for " + std::to_string(entries.size) + " scene entries");
+		}
+	}
+	size_t first = objects->size();
+	objects->reserve(first + entries.size);
+	for (uint32_t i = 0; i < entries.size; ++i) {
+		SceneEntry const &entry = entries[i];
+		objects->emplace_back();
+		Object &object = objects->back();
+		object.name = get_name(strings, entry.name_begin, entry.name_end, file.filename);
+		object.position = entry.position;
+		object.rotation = entry.rotation;
+		object.scale = entry.scale;
+		object.dimension = entry.dimension;
+		if (!parents.empty() && parents[i] != -1U) {
+			if (parents[i] >= i) {
+				throw std::runtime_error("'" + file.filename + "' has a scene entry whose parent doesn't come before it");
+			}
+			object.parent = uint32_t(first + parents[i]);
+		}
+	}
+}
+
+void AssetPackage::cook(std::string const &dir, std::string const &filename, bool optimize, bool compress) {
+	//meshes, as 'cook' would write them:
+	Meshes::File meshes;
+	meshes.read(dir + "/meshes.blob");
+	meshes.quantize();
+	if (meshes.indices.empty()) {
+		meshes.weld();
+		if (optimize) meshes.optimize();
+	}
+	if (!meshes.has_bounds) meshes.compute_bounds();
+	meshes.blob->wait_verified();
+
+	std::vector< Object > objects;
+	{
+		MappedBlob scene(dir + "/scene.blob");
+		read_scene(scene, "str0", &objects);
+	}
+
+	std::vector< char > strings;
+	auto add_string = [&strings](std::string const &str, uint32_t *begin, uint32_t *end) {
+		*begin = uint32_t(strings.size());
+		strings.insert(strings.end(), str.begin(), str.end());
+		*end = uint32_t(strings.size());
+	};
+
+	//textures used by the material table, in order of first use:
+	std::vector< std::string > texture_names;
+	std::vector< MaterialEntry > material_entries;
+	for (auto const &material : default_materials()) {
+		auto f = std::find(texture_names.begin(), texture_names.end(), material.second);
+		MaterialEntry entry;
+		add_string(material.first, &entry.name_begin, &entry.name_end);
+		entry.texture = uint32_t(f - texture_names.begin());
+		if (f == texture_names.end()) texture_names.emplace_back(material.second);
+		material_entries.emplace_back(entry);
+	}
+	auto has_material = [](std::string const &name) {
+		return std::find_if(default_materials().begin(), default_materials().end(), [&name](std::pair< std::string, std::string > const &material) {
+			return material.first == name;
+		}) != default_materials().end();
+	};
+	uint32_t unmaterialed = 0;
+	for (auto const &object : objects) {
+		if (has_material(object.name)) continue;
+		std::string fallback = material_fallback(object.name);
+		if (fallback != "" && has_material(fallback)) continue;
+		if (unmaterialed++ < 10) {
+			std::cerr << "WARNING: scene object '" << object.name << "' has no material." << std::endl;
+		}
+	}
+	if (unmaterialed > 10) {
+		std::cerr << "WARNING: (and " << (unmaterialed - 10) << " more objects with no material)" << std::endl;
+	}
+
+	std::vector< TextureEntry > texture_entries;
+	std::vector< LevelEntry > level_entries;
+	std::vector< uint32_t > texels;
+	//decode and mipmap the textures in parallel (see Mipmaps.hpp), then pack them in order:
+	std::vector< glm::uvec2 > sizes(texture_names.size());
+	std::vector< std::vector< uint32_t > > level0s(texture_names.size());
+	std::vector< std::vector< std::vector< uint32_t > > > mipmaps(texture_names.size());
+	std::vector< char > decoded(texture_names.size(), 0);
+	ThreadPool::shared().parallel_for(uint32_t(texture_names.size()), [&](uint32_t t){
+		decoded[t] = load_png(dir + "/" + texture_names[t], &sizes[t].x, &sizes[t].y, &level0s[t], LowerLeftOrigin);
+		if (decoded[t]) mipmaps[t] = make_mipmaps(sizes[t], level0s[t].data());
+	});
+	for (uint32_t t = 0; t < texture_names.size(); ++t) {
+		std::string const &name = texture_names[t];
+		if (!decoded[t]) {
+			throw std::runtime_error("Failed to load texture '" + dir + "/" + name + "'.");
+		}
+		glm::uvec2 size = sizes[t];
+		TextureEntry entry;
+		add_string(name, &entry.name_begin, &entry.name_end);
+		entry.level_begin = uint32_t(level_entries.size());
+		auto add_level = [&](glm::uvec2 level_size, std::vector< uint32_t > const &data) {
+			LevelEntry level;
+			level.width = level_size.x;
+			level.height = level_size.y;
+			level.offset = texels.size() * sizeof(uint32_t);
+			level_entries.emplace_back(level);
+			texels.insert(texels.end(), data.begin(), data.end());
+		};
+		add_level(size, level0s[t]);
+		for (auto const &mipmap : mipmaps[t]) {
+			size = glm::max(size / 2U, glm::uvec2(1));
+			add_level(size, mipmap);
+		}
+		entry.level_end = uint32_t(level_entries.size());
+		texture_entries.emplace_back(entry);
+	}
+
+	std::vector< SceneEntry > scene_entries;
+	std::vector< uint32_t > parents; //(only written if some object has a parent)
+	bool has_parents = false;
+	for (auto const &object : objects) {
+		parents.emplace_back(object.parent);
+		if (object.parent != -1U) has_parents = true;
+		SceneEntry entry;
+		add_string(object.name, &entry.name_begin, &entry.name_end);
+		entry.position = object.position;
+		entry.rotation = object.rotation;
+		entry.scale = object.scale;
+		entry.dimension = object.dimension;
+		scene_entries.emplace_back(entry);
+	}
+
+	//tables first (small, read at startup), then the bulk data:
+	BlobWriter writer;
+	writer.add_chunk("pst0", strings);
+	writer.add_chunk("tex0", texture_entries);
+	writer.add_chunk("lvl0", level_entries);
+	writer.add_chunk("mtl0", material_entries);
+	writer.add_chunk("scn0", scene_entries);
+	if (has_parents) writer.add_chunk("prn0", parents);
+	meshes.add_chunks(&writer, compress);
+	if (compress) {
+		writer.add_compressed_chunk("txd0", texels.data(), texels.size(), FilterAuto);
+	} else {
+		writer.add_chunk("txd0", texels, 4096);
+	}
+	writer.write(filename);
+
+	std::cout << "Packed " << meshes.entries.size() << " meshes, " << texture_entries.size() << " textures ("
+		<< level_entries.size() << " mip levels, " << texels.size() * sizeof(uint32_t) << " bytes of texels), "
+		<< material_entries.size() << " materials, and " << scene_entries.size() << " scene objects into '" << filename << "'." << std::endl;
+}
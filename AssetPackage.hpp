@@ -0,0 +1,88 @@
+#pragma once
+
+#include "MappedBlob.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+//"AssetPackage" is everything the game loads, prepared offline by 'cook --package' as one versioned
+// blob (see MappedBlob.hpp) that the game maps at startup instead of decoding and processing assets:
+// - meshes, cooked as by 'cook' (quantized, welded, optimized, with precomputed bounds) and stored in
+//   the same chunks as a cooked mesh file, so Meshes loads them straight from the package;
+// - textures, as RGBA8 mipmap chains (lower-left origin, largest level first, see Mipmaps.hpp) ready for glTexImage2D;
+// - the material table, giving the texture each mesh is drawn with;
+// - the scene's objects (and their parents, if the scene has a 'prn0' chunk).
+//Texture, material, and object names are in a 'pst0' strings chunk (mesh names stay in 'str0').
+
+struct AssetPackage {
+	//chunk layouts:
+	struct TextureEntry { //'tex0'
+		uint32_t name_begin, name_end;
+		uint32_t level_begin, level_end; //range of 'lvl0' entries
+	};
+	static_assert(sizeof(TextureEntry) == 16, "TextureEntry is packed");
+	struct LevelEntry { //'lvl0'
+		uint32_t width, height;
+		uint64_t offset; //in bytes, into 'txd0' (the texels, four bytes each)
+	};
+	static_assert(sizeof(LevelEntry) == 16, "LevelEntry is packed");
+	struct MaterialEntry { //'mtl0'
+		uint32_t name_begin, name_end; //mesh name
+		uint32_t texture; //index into 'tex0'
+	};
+	static_assert(sizeof(MaterialEntry) == 12, "MaterialEntry is packed");
+	struct SceneEntry { //'scn0' (same layout as in scene.blob)
+		uint32_t name_begin, name_end;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+		glm::vec3 dimension;
+	};
+	static_assert(sizeof(SceneEntry) == 60, "SceneEntry is packed");
+	//'prn0' (optional) holds a uint32_t per 'scn0' entry: the index of the entry it is parented to
+	// (always an earlier one, so the hierarchy can be built in order), or -1U for none.
+
+	//map a package:
+	// note: will throw if the file can't be read, a chunk is corrupt, or a table entry is out of range.
+	AssetPackage(std::string const &filename);
+
+	struct Level {
+		glm::uvec2 size = glm::uvec2(0);
+		uint32_t const *texels = nullptr; //(in the mapped file)
+	};
+	struct Texture {
+		std::string name; //(the PNG it was made from)
+		std::vector< Level > levels;
+	};
+	struct Object {
+		std::string name; //(also the name of its mesh)
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+		glm::vec3 dimension = glm::vec3(0.0f);
+		uint32_t parent = -1U; //index of the parent object (-1U if none)
+	};
+
+	MappedBlob blob;
+	std::vector< Texture > textures;
+	std::vector< std::pair< std::string, uint32_t > > materials; //mesh name -> index in textures
+	//(the scene's objects are left in the blob for load_scene(), see SceneLoader.hpp)
+
+	//which texture (a PNG in dist/) each mesh is drawn with, as 'cook --package' packs it:
+	static std::vector< std::pair< std::string, std::string > > const &default_materials();
+	//copies of a mesh named with a '.' suffix ('Crate.001', or 'Crate.g17' from 'scenegen') that have no
+	// material of their own use the material of the name before the suffix; this is that name ("" if none):
+	static std::string material_fallback(std::string const &name);
+
+	//read 'scn0' (and 'prn0') entries, with names in the chunk 'strings_magic' (so this also reads scene.blob):
+	// note: will throw if the chunks are missing or a name or parent is out of range.
+	static void read_scene(MappedBlob &file, std::string const &strings_magic, std::vector< Object > *objects);
+
+	//build a package from 'dir'/meshes.blob, 'dir'/scene.blob, and the PNGs named by default_materials():
+	// note: will throw if any of them fail to read, or the package can't be written.
+	static void cook(std::string const &dir, std::string const &filename, bool optimize = true, bool compress = false);
+};
@@ -0,0 +1,288 @@
+#include "AssetStreamer.hpp"
+
+#include "Mipmaps.hpp"
+#include "load_save_png.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+AssetStreamer::AssetStreamer(uint32_t workers, uint32_t slot_count, uint32_t slot_size_) : slot_size(slot_size_) {
+	if (slot_count == 0 || slot_size == 0) {
+		throw std::runtime_error("AssetStreamer needs at least one non-empty staging slot.");
+	}
+	slots.resize(slot_count);
+	glGenBuffers(1, &staging);
+	glBindBuffer(GL_COPY_READ_BUFFER, staging);
+	glBufferData(GL_COPY_READ_BUFFER, GLsizeiptr(slot_count) * slot_size, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	pool.reset(new ThreadPool(workers));
+}
+
+AssetStreamer::~AssetStreamer() {
+	pool.reset(); //(finishes any running loads)
+	for (auto &slot : slots) {
+		if (slot.fence) glDeleteSync(slot.fence);
+	}
+	glDeleteBuffers(1, &staging);
+}
+
+void AssetStreamer::request(std::shared_ptr< Asset > const &asset, std::function< void(Asset &) > const &load) {
+	if (pending_count == 0 && resident_count == 0) {
+		first_request = std::chrono::high_resolution_clock::now();
+	}
+	++pending_count;
+	pool->run([this, asset, load](){
+		std::string failed;
+		try {
+			load(*asset);
+		} catch (std::exception &e) {
+			failed = e.what();
+		}
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			if (failed != "" && asset->on_failed) {
+				failures.emplace_back(asset->on_failed, failed);
+			} else if (failed != "") {
+				if (error == "") error = "Failed to load '" + asset->filename + "': " + failed;
+			} else {
+				ready.emplace_back(new Asset(std::move(*asset)));
+			}
+		}
+		ready_cv.notify_all();
+	});
+}
+
+void AssetStreamer::stream_texture(std::string const &filename, GLuint texture, std::function< void() > const &on_resident,
+	std::function< void(std::string const &what) > const &on_failed) {
+	std::shared_ptr< Asset > asset = std::make_shared< Asset >();
+	asset->filename = filename;
+	asset->texture = texture;
+	asset->on_resident = on_resident;
+	asset->on_failed = on_failed;
+	bool mipmap = mipmaps;
+	request(asset, [mipmap](Asset &asset){
+		asset.levels.resize(1);
+		if (!load_png(asset.filename, &asset.levels[0].size.x, &asset.levels[0].size.y, &asset.pixels, LowerLeftOrigin)) {
+			throw std::runtime_error("not a readable PNG");
+		}
+		asset.levels[0].texels = asset.pixels.data();
+		if (mipmap) {
+			glm::uvec2 size = asset.levels[0].size;
+			asset.mipmaps = make_mipmaps(size, asset.pixels.data());
+			for (uint32_t l = 0; l < asset.mipmaps.size(); ++l) {
+				AssetPackage::Level level;
+				level.size = mip_level_size(size, l + 1);
+				level.texels = asset.mipmaps[l].data();
+				asset.levels.emplace_back(level);
+			}
+		}
+	});
+}
+
+void AssetStreamer::stream_texture(AssetPackage::Texture const &from, GLuint texture, std::function< void() > const &on_resident) {
+	std::shared_ptr< Asset > asset = std::make_shared< Asset >();
+	asset->filename = from.name;
+	asset->texture = texture;
+	asset->levels = from.levels;
+	if (!mipmaps) asset->levels.resize(std::min< size_t >(asset->levels.size(), 1));
+	asset->on_resident = on_resident;
+	request(asset, [](Asset &){ }); //(already decoded)
+}
+
+void AssetStreamer::stream_meshes(std::string const &filename, Meshes *meshes, Meshes::Attributes const &attributes, std::function< void() > const &on_resident) {
+	std::shared_ptr< Asset > asset = std::make_shared< Asset >();
+	asset->filename = filename;
+	asset->meshes = meshes;
+	asset->attributes = attributes;
+	asset->on_resident = on_resident;
+	request(asset, [](Asset &asset){
+		asset.file.reset(new Meshes::File(asset.meshes->prepare_load(asset.filename)));
+	});
+}
+
+void AssetStreamer::update() {
+	upload(false);
+}
+
+void AssetStreamer::finish() {
+	while (pending_count) {
+		upload(true);
+		if (!pending_count) break;
+		std::unique_lock< std::mutex > lock(mutex);
+		ready_cv.wait(lock, [this](){ return !ready.empty() || !failures.empty() || error != ""; });
+	}
+}
+
+void AssetStreamer::upload(bool unlimited) {
+	auto start = std::chrono::high_resolution_clock::now();
+	bool uploaded = false;
+
+	{ //requests that failed with an 'on_failed' callback are reported and dropped:
+		std::deque< std::pair< std::function< void(std::string const &) >, std::string > > failed;
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			failed.swap(failures);
+		}
+		for (auto &f : failed) {
+			--pending_count;
+			f.first(f.second);
+		}
+		if (!failed.empty() && pending_count == 0) drained = true;
+	}
+
+	while (true) {
+		if (!uploading) {
+			std::unique_lock< std::mutex > lock(mutex);
+			if (error != "") throw std::runtime_error(error);
+			if (ready.empty()) break;
+			uploading = std::move(ready.front());
+			ready.pop_front();
+			lock.unlock();
+			begin(*uploading);
+		}
+
+		Asset &asset = *uploading;
+		if (asset.stream < asset.streams.size()) {
+			Stream &stream = asset.streams[asset.stream];
+			if (stream.done < stream.size) {
+				if (!upload_slice(stream)) {
+					if (!unlimited) {
+						++stalls;
+						break;
+					}
+					//(waiting is fine when finishing)
+					Slot &slot = slots[next_slot];
+					glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+					continue;
+				}
+				uploaded = true;
+			}
+			if (stream.done == stream.size) ++asset.stream;
+		}
+		if (asset.stream == asset.streams.size()) {
+			complete(asset);
+			uploading.reset();
+		}
+
+		double elapsed = std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - start).count();
+		if (!unlimited && uploaded && elapsed >= budget_ms) break;
+	}
+
+	if (uploaded) {
+		++busy_updates;
+		double elapsed = std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - start).count();
+		longest_update_ms = std::max(longest_update_ms, elapsed);
+	}
+
+	if (drained) {
+		drained = false;
+		double elapsed = std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - first_request).count();
+		std::cout << "AssetStreamer: " << resident_count << " assets (" << bytes_uploaded << " bytes) resident "
+			<< elapsed << " ms after the first request (loaded on " << pool->size() << " threads); uploads took " << busy_updates << " updates (longest "
+			<< longest_update_ms << " ms), " << stalls << " stalls." << std::endl;
+	}
+}
+
+void AssetStreamer::begin(Asset &asset) {
+	if (asset.file) { //meshes: allocate room in the geometry arena, stream vertices and indices
+		Meshes::File &file = *asset.file;
+		asset.placement = asset.meshes->place(file, asset.attributes);
+		GeometryArena *arena = asset.placement.arena;
+
+		Stream vertices;
+		vertices.data = reinterpret_cast< uint8_t const * >(file.packed.data);
+		vertices.size = asset.placement.vertices.size;
+		vertices.granularity = 4;
+		vertices.buffer = &arena->vertex_buffer;
+		vertices.offset = asset.placement.vertices.offset;
+		asset.streams.emplace_back(vertices);
+
+		Stream indices;
+		indices.data = reinterpret_cast< uint8_t const * >(file.index_data());
+		indices.size = asset.placement.indices.size;
+		indices.granularity = 4;
+		indices.buffer = &arena->index_buffer;
+		indices.offset = asset.placement.indices.offset;
+		asset.streams.emplace_back(indices);
+	} else { //texture: allocate storage for each level, stream rows
+		if (asset.levels.empty() || asset.levels[0].size.x * sizeof(uint32_t) > slot_size) {
+			throw std::runtime_error("Rows of '" + asset.filename + "' are larger than a staging slot.");
+		}
+		glBindTexture(GL_TEXTURE_2D, asset.texture);
+		for (uint32_t l = 0; l < asset.levels.size(); ++l) {
+			AssetPackage::Level const &level = asset.levels[l];
+			Stream stream;
+			stream.data = reinterpret_cast< uint8_t const * >(level.texels);
+			stream.size = size_t(level.size.x) * level.size.y * sizeof(uint32_t);
+			stream.granularity = level.size.x * sizeof(uint32_t);
+			stream.texture = asset.texture;
+			stream.level = GLint(l);
+			stream.width = level.size.x;
+			asset.streams.emplace_back(stream);
+			glTexImage2D(GL_TEXTURE_2D, GLint(l), GL_RGBA, level.size.x, level.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(asset.levels.size()) - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		bool trilinear = (asset.levels.size() > 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, trilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, trilinear ? GL_LINEAR : GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+bool AssetStreamer::upload_slice(Stream &stream) {
+	Slot &slot = slots[next_slot];
+	if (slot.fence) {
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) return false;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+	}
+
+	size_t bytes = std::min(stream.size - stream.done, size_t(slot_size) / stream.granularity * stream.granularity);
+	GLintptr offset = GLintptr(next_slot) * slot_size;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, staging);
+	void *mapped = glMapBufferRange(GL_COPY_READ_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!mapped) {
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		throw std::runtime_error("Failed to map staging buffer.");
+	}
+	std::memcpy(mapped, stream.data + stream.done, bytes);
+	glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+	if (stream.buffer) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, *stream.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, stream.offset + stream.done, bytes);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	} else {
+		GLint row = GLint(stream.done / stream.granularity);
+		GLsizei rows = GLsizei(bytes / stream.granularity);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+		glBindTexture(GL_TEXTURE_2D, stream.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, stream.level, 0, row, stream.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0 + offset);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	next_slot = (next_slot + 1) % slots.size();
+	stream.done += bytes;
+	bytes_uploaded += bytes;
+	return true;
+}
+
+void AssetStreamer::complete(Asset &asset) {
+	if (asset.file) {
+		asset.meshes->finish_load(*asset.file, asset.placement);
+	}
+	--pending_count;
+	++resident_count;
+	if (asset.on_resident) asset.on_resident();
+	if (pending_count == 0) drained = true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "GL.hpp"
+#include "AssetPackage.hpp"
+#include "Meshes.hpp"
+#include "ThreadPool.hpp"
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+//"AssetStreamer" loads assets in the background so the game can start drawing before they all arrive:
+// worker threads read and decode files (PNG decoding, Meshes::prepare_load()), each request a separate job;
+// update() (on the GL thread, once per frame) copies decoded data to the GPU for at most 'budget_ms',
+// a slice at a time, through a ring of staging slots in one buffer object that lives as long as the streamer.
+// Each slot is fenced after its copy is issued and only reused once the fence signals, so uploads never
+// wait on the GPU (if every slot is busy, update() stops early and counts a stall).
+// (GL 3.3 has no persistent mapping, so each slice maps its slot with GL_MAP_UNSYNCHRONIZED_BIT instead.)
+//
+//Each request's 'on_resident' callback runs inside update() (or finish()) once all of its data has been copied.
+
+struct AssetStreamer {
+	//'workers' threads load requests (0 means one per hardware thread, see ThreadPool.hpp):
+	AssetStreamer(uint32_t workers = 2, uint32_t slots = 4, uint32_t slot_size = 256 * 1024);
+	~AssetStreamer();
+	AssetStreamer(AssetStreamer const &) = delete;
+
+	//decode a PNG (RGBA8, lower-left origin) into 'texture' (an existing texture name; storage is
+	// allocated once the size is known; sampling is clamped, and trilinear if the texture has mipmaps,
+	// nearest otherwise). Storage is re-specified when the upload starts, so don't draw 'texture' until
+	// 'on_resident'; to replace a texture that is in use, stream into a new name and swap it in then.
+	//If 'on_failed' is given, a PNG that can't be read is passed to it (from update() or finish()) and
+	// dropped, rather than failing the streamer (see update()):
+	void stream_texture(std::string const &filename, GLuint texture, std::function< void() > const &on_resident,
+		std::function< void(std::string const &what) > const &on_failed = nullptr);
+
+	//upload a texture that is already decoded, with all of its mipmap levels (e.g., from an AssetPackage,
+	// which must stay mapped until the texture is resident):
+	void stream_texture(AssetPackage::Texture const &from, GLuint texture, std::function< void() > const &on_resident);
+
+	//load a mesh file (as Meshes::load() would) and add its meshes to 'meshes' once they are resident:
+	void stream_meshes(std::string const &filename, Meshes *meshes, Meshes::Attributes const &attributes, std::function< void() > const &on_resident);
+
+	//upload decoded data for up to budget_ms (always at least one slice, so loading can't stall):
+	// note: will throw if an asset failed to load (and its request had no 'on_failed' callback).
+	void update();
+
+	//upload everything, waiting for workers as needed:
+	void finish();
+
+	//requests that aren't resident yet:
+	uint32_t pending() const { return pending_count; }
+
+	double budget_ms = 2.0;
+
+	//give decoded PNGs full mipmap chains (built by the worker that decodes them, see Mipmaps.hpp) and
+	// upload every level of packaged textures; otherwise textures are just level 0:
+	bool mipmaps = true;
+
+	//stats (printed when the last pending asset becomes resident):
+	uint64_t bytes_uploaded = 0;
+	uint32_t busy_updates = 0; //update() calls that uploaded something
+	uint32_t stalls = 0; //update() calls cut short because every staging slot was in flight
+	double longest_update_ms = 0.0;
+
+	//internals:
+	struct Stream { //bytes to copy into a buffer or the rows of a texture
+		uint8_t const *data = nullptr;
+		size_t size = 0;
+		size_t granularity = 1; //slices are multiples of this (one row, for textures)
+		GLuint const *buffer = nullptr; //(read for each slice, since arenas rename their buffers when they grow)
+		size_t offset = 0; //where the data goes in 'buffer'
+		GLuint texture = 0;
+		GLint level = 0;
+		uint32_t width = 0;
+		size_t done = 0;
+	};
+	struct Asset {
+		std::string filename;
+		std::function< void() > on_resident;
+		std::function< void(std::string const &what) > on_failed; //(if empty, failing to load is an error)
+		//textures:
+		GLuint texture = 0;
+		std::vector< AssetPackage::Level > levels;
+		std::vector< uint32_t > pixels; //(decoded PNGs; levels[0] points here)
+		std::vector< std::vector< uint32_t > > mipmaps; //(and levels[1...] here)
+		//meshes:
+		Meshes *meshes = nullptr;
+		Meshes::Attributes attributes;
+		std::unique_ptr< Meshes::File > file;
+		Meshes::Placement placement;
+		//upload:
+		std::vector< Stream > streams;
+		uint32_t stream = 0;
+	};
+	struct Slot {
+		GLsync fence = 0;
+	};
+
+	uint32_t slot_size;
+	GLuint staging = 0;
+	std::vector< Slot > slots;
+	uint32_t next_slot = 0;
+
+	uint32_t pending_count = 0;
+	uint32_t resident_count = 0;
+	bool drained = false; //(report stats at the end of this upload)
+	std::chrono::high_resolution_clock::time_point first_request;
+	std::unique_ptr< Asset > uploading;
+
+	//filled by workers:
+	std::mutex mutex;
+	std::condition_variable ready_cv;
+	std::deque< std::unique_ptr< Asset > > ready;
+	std::string error;
+	std::deque< std::pair< std::function< void(std::string const &) >, std::string > > failures; //(requests with on_failed)
+
+	void upload(bool unlimited);
+	void begin(Asset &asset);
+	bool upload_slice(Stream &stream); //false if no staging slot is free
+	void complete(Asset &asset);
+	void request(std::shared_ptr< Asset > const &asset, std::function< void(Asset &) > const &load);
+
+	std::unique_ptr< ThreadPool > pool; //(last, so workers are stopped before the rest is destroyed)
+};
@@ -0,0 +1,74 @@
+#include "AsyncReadback.hpp"
+
+#include <cassert>
+
+AsyncReadback::AsyncReadback(glm::uvec2 const &size_, uint32_t buffers) : size(size_) {
+	assert(buffers > 0);
+	slots.resize(buffers);
+	for (auto &slot : slots) {
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+AsyncReadback::~AsyncReadback() {
+	for (auto &slot : slots) {
+		if (slot.fence) glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.buffer);
+	}
+}
+
+bool AsyncReadback::read(uint64_t tag) {
+	if (in_flight == slots.size()) {
+		++dropped;
+		return false;
+	}
+	Slot &slot = slots[(oldest + in_flight) % slots.size()];
+	++in_flight;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.tag = tag;
+	return true;
+}
+
+void AsyncReadback::finish_oldest(Callback const &on_frame) {
+	assert(in_flight > 0);
+	Slot &slot = slots[oldest];
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	void const *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size.x * size.y * 4, GL_MAP_READ_BIT);
+	if (pixels) {
+		on_frame(slot.tag, reinterpret_cast< uint32_t const * >(pixels));
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	} else {
+		++dropped;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	oldest = (oldest + 1) % slots.size();
+	--in_flight;
+}
+
+void AsyncReadback::poll(Callback const &on_frame) {
+	while (in_flight > 0) {
+		GLenum status = glClientWaitSync(slots[oldest].fence, 0, 0); //timeout of zero: just check
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		finish_oldest(on_frame);
+	}
+}
+
+void AsyncReadback::flush(Callback const &on_frame) {
+	while (in_flight > 0) {
+		glClientWaitSync(slots[oldest].fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+		finish_oldest(on_frame);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+//"AsyncReadback" reads rendered frames back from the GPU without stalling the pipeline:
+// read() starts a glReadPixels into one of a ring of pixel-pack buffers and inserts a fence;
+// poll() (a few frames later) maps the buffers whose fences have signalled and passes their pixels on.
+// If every buffer is still in flight, read() drops the frame (counting it in 'dropped') rather than wait.
+
+struct AsyncReadback {
+	AsyncReadback(glm::uvec2 const &size, uint32_t buffers = 3);
+	~AsyncReadback();
+	AsyncReadback(AsyncReadback const &) = delete;
+
+	//start reading back the currently bound read framebuffer; 'tag' is passed along to the callback:
+	// returns false if the frame was dropped.
+	bool read(uint64_t tag);
+
+	//pixels are RGBA8, row 0 at the bottom; only valid during the callback:
+	typedef std::function< void(uint64_t tag, uint32_t const *pixels) > Callback;
+
+	//hand off every finished readback (oldest first) without blocking:
+	void poll(Callback const &on_frame);
+
+	//wait for (and hand off) every readback still in flight:
+	void flush(Callback const &on_frame);
+
+	glm::uvec2 size;
+	uint32_t dropped = 0;
+
+	//internals:
+	struct Slot {
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		uint64_t tag = 0;
+	};
+	std::vector< Slot > slots;
+	uint32_t oldest = 0; //index of oldest in-flight slot
+	uint32_t in_flight = 0;
+	void finish_oldest(Callback const &on_frame);
+};
@@ -0,0 +1,91 @@
+#include "BlobWriter.hpp"
+#include "Checksum.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+void BlobWriter::add_bytes(std::string const &magic, void const *data, size_t size, uint32_t alignment) {
+	if (magic.size() != 4) {
+		throw std::runtime_error("Chunk magic '" + magic + "' is not four characters.");
+	}
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+		throw std::runtime_error("Alignment of chunk '" + magic + "' is not a power of two.");
+	}
+	chunks.emplace_back();
+	Chunk &chunk = chunks.back();
+	for (uint32_t i = 0; i < 4; ++i) {
+		chunk.entry.magic[i] = magic[i];
+	}
+	chunk.entry.alignment = alignment;
+	chunk.entry.size = size;
+	chunk.entry.crc = crc32c(data, size);
+	chunk.data = data;
+}
+
+void BlobWriter::add_compressed_bytes(std::string const &magic, void const *data, size_t size, ChunkFilter filter, uint32_t element_size) {
+	owned.emplace_back(compress_chunk(data, size, filter, element_size));
+	add_bytes(magic, owned.back().data(), owned.back().size(), 16);
+	chunks.back().entry.flags |= BlobChunkCompressed;
+}
+
+void BlobWriter::add_copied_bytes(std::string const &magic, void const *data, size_t size, uint32_t alignment) {
+	uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+	owned.emplace_back(bytes, bytes + size);
+	add_bytes(magic, owned.back().data(), size, alignment);
+}
+
+void BlobWriter::write(std::string const &filename) const {
+	//written beside 'filename' and renamed over it, so chunk data may point into a mapping of 'filename'
+	// itself (e.g., cooking a file in place), and readers never see a half-written file:
+	std::string temp = filename + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary);
+		write(file);
+		if (!file.flush()) {
+			file.close();
+			std::remove(temp.c_str());
+			throw std::runtime_error("Failed to write '" + temp + "'.");
+		}
+	}
+#ifdef _WIN32
+	std::remove(filename.c_str()); //(rename won't replace an existing file here)
+#endif
+	if (std::rename(temp.c_str(), filename.c_str()) != 0) {
+		std::remove(temp.c_str());
+		throw std::runtime_error("Failed to replace '" + filename + "' with '" + temp + "'.");
+	}
+}
+
+void BlobWriter::write(std::ostream &file) const {
+	//lay out chunks after the table of contents:
+	std::vector< BlobTocEntry > toc;
+	toc.reserve(chunks.size());
+	uint64_t offset = sizeof(BlobHeader) + chunks.size() * sizeof(BlobTocEntry);
+	for (auto const &chunk : chunks) {
+		toc.emplace_back(chunk.entry);
+		offset = (offset + chunk.entry.alignment - 1) & ~uint64_t(chunk.entry.alignment - 1);
+		toc.back().offset = offset;
+		offset += chunk.entry.size;
+	}
+
+	BlobHeader header;
+	header.version = MappedBlob::Version;
+	header.chunk_count = uint32_t(toc.size());
+	header.toc_crc = crc32c(toc.data(), toc.size() * sizeof(BlobTocEntry));
+
+	file.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	file.write(reinterpret_cast< char const * >(toc.data()), toc.size() * sizeof(BlobTocEntry));
+	uint64_t at = sizeof(BlobHeader) + toc.size() * sizeof(BlobTocEntry);
+	static char const zeros[64] = { 0 };
+	for (uint32_t i = 0; i < chunks.size(); ++i) {
+		while (at < toc[i].offset) {
+			uint64_t pad = std::min< uint64_t >(sizeof(zeros), toc[i].offset - at);
+			file.write(zeros, pad);
+			at += pad;
+		}
+		file.write(reinterpret_cast< char const * >(chunks[i].data), toc[i].size);
+		at += toc[i].size;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MappedBlob.hpp"
+#include "Compression.hpp"
+
+#include <iosfwd>
+#include <list>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+//"BlobWriter" writes versioned chunk files (layout in MappedBlob.hpp):
+// add chunks, then write() them all at once with a table of contents in front.
+//Chunk data is not copied, so it must stay valid until write() is called
+// (except for compressed chunks, which are compressed as they are added, and add_chunk_copy()).
+
+struct BlobWriter {
+	//add a chunk of 'count' elements at 'data', to be placed at a multiple of 'alignment' bytes:
+	template< typename T >
+	void add_chunk(std::string const &magic, T const *data, size_t count, uint32_t alignment = 16) {
+		add_bytes(magic, data, count * sizeof(T), alignment);
+	}
+	template< typename T >
+	void add_chunk(std::string const &magic, std::vector< T > const &data, uint32_t alignment = 16) {
+		add_bytes(magic, data.data(), data.size() * sizeof(T), alignment);
+	}
+
+	//add a chunk from a copy of 'data' (for data that won't last until write()):
+	template< typename T >
+	void add_chunk_copy(std::string const &magic, std::vector< T > const &data, uint32_t alignment = 16) {
+		add_copied_bytes(magic, data.data(), data.size() * sizeof(T), alignment);
+	}
+
+	//add a compressed chunk (see Compression.hpp; the filter works on whole elements of T):
+	template< typename T >
+	void add_compressed_chunk(std::string const &magic, T const *data, size_t count, ChunkFilter filter = FilterNone) {
+		add_compressed_bytes(magic, data, count * sizeof(T), filter, sizeof(T));
+	}
+
+	//write header, table of contents, and chunks (to 'filename'.tmp, then renamed into place):
+	// note: will throw if the file can't be written.
+	void write(std::string const &filename) const;
+	//(or to a stream, e.g. to build a blob in memory):
+	void write(std::ostream &to) const;
+
+	//internals:
+	struct Chunk {
+		BlobTocEntry entry;
+		void const *data;
+	};
+	std::vector< Chunk > chunks;
+	std::list< std::vector< uint8_t > > owned; //data of compressed and copied chunks
+	void add_bytes(std::string const &magic, void const *data, size_t size, uint32_t alignment);
+	void add_copied_bytes(std::string const &magic, void const *data, size_t size, uint32_t alignment);
+	void add_compressed_bytes(std::string const &magic, void const *data, size_t size, ChunkFilter filter, uint32_t element_size);
+};
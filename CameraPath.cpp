@@ -0,0 +1,62 @@
+#include "CameraPath.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+void CameraPath::load(std::string const &filename) {
+	std::ifstream file(filename);
+	if (!file) {
+		throw std::runtime_error("Failed to open camera path '" + filename + "'.");
+	}
+	keyframes.clear();
+	std::string line;
+	uint32_t line_number = 0;
+	while (std::getline(file, line)) {
+		++line_number;
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream str(line);
+		Keyframe key;
+		if (!(str >> key.time >> key.radius >> key.elevation >> key.azimuth)) {
+			throw std::runtime_error("Malformed keyframe on line " + std::to_string(line_number) + " of '" + filename + "'.");
+		}
+		str >> key.target.x >> key.target.y >> key.target.z; //target is optional
+		keyframes.emplace_back(key);
+	}
+	if (keyframes.empty()) {
+		throw std::runtime_error("Camera path '" + filename + "' has no keyframes.");
+	}
+	std::stable_sort(keyframes.begin(), keyframes.end(), [](Keyframe const &a, Keyframe const &b) {
+		return a.time < b.time;
+	});
+}
+
+CameraPath CameraPath::orbit(float duration) {
+	CameraPath path;
+	path.keyframes.resize(2);
+	path.keyframes[0].elevation = path.keyframes[1].elevation = 0.3f;
+	path.keyframes[1].time = duration;
+	path.keyframes[1].azimuth = 2.0f * float(M_PI);
+	return path;
+}
+
+CameraPath::Keyframe CameraPath::sample(float t) const {
+	if (keyframes.empty()) return Keyframe();
+	if (t <= keyframes.front().time) return keyframes.front();
+	if (t >= keyframes.back().time) return keyframes.back();
+
+	auto after = std::upper_bound(keyframes.begin(), keyframes.end(), t, [](float time, Keyframe const &k) {
+		return time < k.time;
+	});
+	auto before = after - 1;
+	float amt = (t - before->time) / (after->time - before->time);
+
+	Keyframe ret;
+	ret.time = t;
+	ret.radius = glm::mix(before->radius, after->radius, amt);
+	ret.elevation = glm::mix(before->elevation, after->elevation, amt);
+	ret.azimuth = glm::mix(before->azimuth, after->azimuth, amt);
+	ret.target = glm::mix(before->target, after->target, amt);
+	return ret;
+}
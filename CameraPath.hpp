@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+//"CameraPath" is a scripted orbit-camera path, used to drive the camera in headless runs.
+// It is loaded from a text file with one keyframe per line:
+//   time radius elevation azimuth [target_x target_y target_z]
+// (times in seconds, angles in radians; blank lines and lines starting with '#' are ignored)
+// Keyframes are linearly interpolated; the path holds its first/last keyframe outside its time range.
+
+struct CameraPath {
+	struct Keyframe {
+		float time = 0.0f;
+		float radius = 5.0f;
+		float elevation = 0.0f;
+		float azimuth = 0.0f;
+		glm::vec3 target = glm::vec3(0.0f, 0.0f, 0.0f);
+	};
+	std::vector< Keyframe > keyframes; //sorted by time
+
+	//load keyframes from a file:
+	// note: will throw if file fails to read or is malformed.
+	void load(std::string const &filename);
+
+	//default path: one slow orbit around the origin over 'duration' seconds:
+	static CameraPath orbit(float duration);
+
+	//interpolated camera parameters at time 't':
+	Keyframe sample(float t) const;
+};
@@ -0,0 +1,105 @@
+#include "Checksum.hpp"
+
+#include <cstring>
+
+//SSE4.2's crc32 instruction computes CRC-32C directly; it is used when the CPU has it
+// (checked at run time, so builds don't need -msse4.2):
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CHECKSUM_SSE42 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//reflected polynomial 0x1EDC6F41:
+static uint32_t const Polynomial = 0x82f63b78;
+
+namespace {
+//slicing-by-8 tables: entries[0] is the usual byte-at-a-time table;
+// entries[k][b] is the CRC of byte b followed by k zero bytes, so eight bytes can be folded in with eight lookups:
+struct Tables {
+	uint32_t entries[8][256];
+	Tables() {
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t crc = i;
+			for (uint32_t bit = 0; bit < 8; ++bit) {
+				crc = (crc >> 1) ^ (Polynomial & (0 - (crc & 1)));
+			}
+			entries[0][i] = crc;
+		}
+		for (uint32_t k = 1; k < 8; ++k) {
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t prev = entries[k - 1][i];
+				entries[k][i] = (prev >> 8) ^ entries[0][prev & 0xff];
+			}
+		}
+	}
+};
+}
+
+uint32_t crc32c_software(void const *data_, size_t size, uint32_t crc) {
+	static Tables const tables;
+	auto const &t = tables.entries;
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(data_);
+	crc = ~crc;
+	for (; size >= 8; data += 8, size -= 8) {
+		//(bytes assembled little-endian, so this works on any host)
+		uint32_t lo = crc ^ (uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24));
+		uint32_t hi = uint32_t(data[4]) | (uint32_t(data[5]) << 8) | (uint32_t(data[6]) << 16) | (uint32_t(data[7]) << 24);
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+		    ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	for (; size > 0; ++data, --size) {
+		crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+#ifdef CHECKSUM_SSE42
+#ifdef __GNUC__
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t crc32c_sse42(void const *data_, size_t size, uint32_t crc) {
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(data_);
+	uint64_t crc64 = ~crc;
+	for (; size > 0 && (reinterpret_cast< uintptr_t >(data) & 7) != 0; ++data, --size) {
+		crc64 = _mm_crc32_u8(uint32_t(crc64), *data);
+	}
+	for (; size >= 8; data += 8, size -= 8) {
+		uint64_t word;
+		std::memcpy(&word, data, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	for (; size > 0; ++data, --size) {
+		crc64 = _mm_crc32_u8(uint32_t(crc64), *data);
+	}
+	return ~uint32_t(crc64);
+}
+
+static bool cpu_has_sse42() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+bool crc32c_hardware() {
+#ifdef CHECKSUM_SSE42
+	static bool const has = cpu_has_sse42();
+	return has;
+#else
+	return false;
+#endif
+}
+
+uint32_t crc32c(void const *data, size_t size, uint32_t crc) {
+#ifdef CHECKSUM_SSE42
+	if (crc32c_hardware()) return crc32c_sse42(data, size, crc);
+#endif
+	return crc32c_software(data, size, crc);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//CRC-32C (Castagnoli polynomial, as used by iSCSI, ext4, and SSE4.2's crc32 instruction):
+// pass a previous result as 'crc' to continue a checksum across several calls.
+// Uses the crc32 instruction when the CPU has SSE4.2 (see crc32c_hardware()), and slicing-by-8
+// tables otherwise (crc32c_software(), which gives the same results anywhere).
+uint32_t crc32c(void const *data, size_t size, uint32_t crc = 0);
+uint32_t crc32c_software(void const *data, size_t size, uint32_t crc = 0);
+bool crc32c_hardware();
@@ -0,0 +1,279 @@
+#include "Compression.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+//------------ LZ codec ------------
+
+static uint32_t const MinMatch = 4;
+static uint32_t const MaxOffset = 0xffff;
+static uint32_t const HashBits = 14;
+
+static inline uint32_t read32(uint8_t const *at) {
+	uint32_t value;
+	std::memcpy(&value, at, 4);
+	return value;
+}
+
+static inline uint32_t hash4(uint32_t value) {
+	return (value * 2654435761u) >> (32 - HashBits);
+}
+
+static void put_length(std::vector< uint8_t > *out, size_t length) {
+	while (length >= 255) {
+		out->emplace_back(255);
+		length -= 255;
+	}
+	out->emplace_back(uint8_t(length));
+}
+
+static void put_sequence(std::vector< uint8_t > *out, uint8_t const *literals, size_t literal_count, size_t offset, size_t match_length) {
+	size_t match_code = (match_length ? match_length - MinMatch : 0);
+	uint8_t token = uint8_t((std::min< size_t >(literal_count, 15) << 4) | std::min< size_t >(match_code, 15));
+	out->emplace_back(token);
+	if (literal_count >= 15) put_length(out, literal_count - 15);
+	out->insert(out->end(), literals, literals + literal_count);
+	if (match_length == 0) return; //(final literals)
+	out->emplace_back(uint8_t(offset & 0xff));
+	out->emplace_back(uint8_t(offset >> 8));
+	if (match_code >= 15) put_length(out, match_code - 15);
+}
+
+void lz_compress(uint8_t const *data, size_t size, std::vector< uint8_t > *out) {
+	std::vector< uint32_t > table(size_t(1) << HashBits, uint32_t(-1)); //last position with each hash
+
+	size_t anchor = 0; //start of pending literals
+	size_t at = 0;
+	//(matches stop short of the end, so the block always finishes with some literals)
+	size_t const match_limit = (size > MinMatch ? size - MinMatch : 0);
+	while (at < match_limit) {
+		uint32_t value = read32(data + at);
+		uint32_t &slot = table[hash4(value)];
+		size_t candidate = slot;
+		slot = uint32_t(at);
+		if (candidate == uint32_t(-1) || at - candidate > MaxOffset || read32(data + candidate) != value) {
+			++at;
+			continue;
+		}
+		size_t length = MinMatch;
+		while (at + length < size && data[candidate + length] == data[at + length]) ++length;
+
+		put_sequence(out, data + anchor, at - anchor, at - candidate, length);
+		at += length;
+		anchor = at;
+	}
+	put_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+static void corrupt(char const *what) {
+	throw std::runtime_error(std::string("Compressed data is corrupt (") + what + ").");
+}
+
+static inline size_t get_length(uint8_t const *&in, uint8_t const *end, size_t length) {
+	if (length != 15) return length;
+	while (true) {
+		if (in >= end) corrupt("length runs past the end");
+		uint8_t more = *in++;
+		length += more;
+		if (more != 255) return length;
+	}
+}
+
+void lz_decompress(uint8_t const *data, size_t size, uint8_t *out, size_t out_size) {
+	uint8_t const *in = data;
+	uint8_t const *in_end = data + size;
+	uint8_t *op = out;
+	uint8_t *op_end = out + out_size;
+	while (true) {
+		if (in >= in_end) corrupt("missing token");
+		uint8_t token = *in++;
+
+		size_t literals = get_length(in, in_end, token >> 4);
+		if (size_t(in_end - in) < literals) corrupt("literals run past the input");
+		if (size_t(op_end - op) < literals) corrupt("literals run past the output");
+		std::memcpy(op, in, literals);
+		in += literals;
+		op += literals;
+		if (in == in_end) break; //(final literals)
+
+		if (in_end - in < 2) corrupt("missing offset");
+		size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > size_t(op - out)) corrupt("offset out of range");
+		size_t length = get_length(in, in_end, token & 0xf) + MinMatch;
+		if (size_t(op_end - op) < length) corrupt("match runs past the output");
+
+		uint8_t const *match = op - offset;
+		if (offset >= length) {
+			std::memcpy(op, match, length);
+			op += length;
+		} else {
+			//(overlapping match repeats the last 'offset' bytes)
+			for (size_t i = 0; i < length; ++i) *op++ = *match++;
+		}
+	}
+	if (op != op_end) corrupt("decoded size mismatch");
+}
+
+//------------ filters ------------
+
+static void apply_filter(uint8_t const *in, size_t size, uint32_t filter, uint32_t element_size, uint8_t *out) {
+	size_t count = (filter == FilterNone ? 0 : size / element_size);
+	size_t shuffled = count * element_size;
+	for (size_t i = 0; i < count; ++i) {
+		for (uint32_t b = 0; b < element_size; ++b) {
+			out[b * count + i] = in[i * element_size + b];
+		}
+	}
+	std::memcpy(out + shuffled, in + shuffled, size - shuffled); //(a partial element at the end is left alone)
+	if (filter == FilterShuffleDelta) {
+		for (size_t i = shuffled; i > 1; --i) {
+			out[i - 1] = uint8_t(out[i - 1] - out[i - 2]);
+		}
+	}
+}
+
+static void undo_filter(uint8_t *data, size_t size, uint32_t filter, uint32_t element_size, std::vector< uint8_t > *scratch) {
+	if (filter == FilterNone) return;
+	size_t count = size / element_size;
+	size_t shuffled = count * element_size;
+	if (filter == FilterShuffleDelta) {
+		for (size_t i = 1; i < shuffled; ++i) {
+			data[i] = uint8_t(data[i] + data[i - 1]);
+		}
+	}
+	scratch->assign(data, data + shuffled);
+	for (size_t i = 0; i < count; ++i) {
+		for (uint32_t b = 0; b < element_size; ++b) {
+			data[i * element_size + b] = (*scratch)[b * count + i];
+		}
+	}
+}
+
+//------------ chunks ------------
+
+//run fn(i) for each block on the shared pool, rethrowing the first exception on the calling thread:
+static void for_each_block(uint32_t count, std::function< void(uint32_t) > const &fn) {
+	std::mutex mutex;
+	std::string error;
+	auto run = [&](uint32_t i) {
+		try {
+			fn(i);
+		} catch (std::exception &e) {
+			std::unique_lock< std::mutex > lock(mutex);
+			if (error == "") error = e.what();
+		}
+	};
+	if (count <= 1) {
+		for (uint32_t i = 0; i < count; ++i) run(i);
+	} else {
+		ThreadPool::shared().parallel_for(count, run);
+	}
+	if (error != "") throw std::runtime_error(error);
+}
+
+std::vector< uint8_t > compress_chunk(void const *data_, size_t size, ChunkFilter filter, uint32_t element_size, uint32_t block_size) {
+	if (filter == FilterAuto) {
+		std::vector< uint8_t > best;
+		for (ChunkFilter attempt : { FilterNone, FilterShuffle, FilterShuffleDelta }) {
+			std::vector< uint8_t > compressed = compress_chunk(data_, size, attempt, element_size, block_size);
+			if (best.empty() || compressed.size() < best.size()) best.swap(compressed);
+		}
+		return best;
+	}
+	if (filter > FilterShuffleDelta) {
+		throw std::runtime_error("Unknown compression filter " + std::to_string(filter) + ".");
+	}
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(data_);
+	if (element_size == 0 || block_size < element_size || (StoredBlock & block_size)) {
+		throw std::runtime_error("Bad compressed chunk block size (" + std::to_string(block_size) + ") or element size (" + std::to_string(element_size) + ").");
+	}
+	block_size -= block_size % element_size;
+
+	CompressedChunkHeader header;
+	header.size = size;
+	header.block_size = block_size;
+	header.block_count = uint32_t((size + block_size - 1) / block_size);
+	header.element_size = element_size;
+	header.filter = filter;
+
+	std::vector< std::vector< uint8_t > > blocks(header.block_count);
+	std::vector< uint32_t > sizes(header.block_count);
+	for_each_block(header.block_count, [&](uint32_t b) {
+		size_t begin = size_t(b) * block_size;
+		size_t length = std::min< size_t >(block_size, size - begin);
+		std::vector< uint8_t > filtered(length);
+		apply_filter(data + begin, length, filter, element_size, filtered.data());
+		lz_compress(filtered.data(), length, &blocks[b]);
+		if (blocks[b].size() >= length) {
+			blocks[b].swap(filtered);
+			sizes[b] = uint32_t(length) | StoredBlock;
+		} else {
+			sizes[b] = uint32_t(blocks[b].size());
+		}
+	});
+
+	std::vector< uint8_t > out(sizeof(header) + sizes.size() * sizeof(uint32_t));
+	std::memcpy(out.data(), &header, sizeof(header));
+	std::memcpy(out.data() + sizeof(header), sizes.data(), sizes.size() * sizeof(uint32_t));
+	for (auto const &block : blocks) {
+		out.insert(out.end(), block.begin(), block.end());
+	}
+	return out;
+}
+
+static CompressedChunkHeader read_header(void const *chunk, size_t size) {
+	CompressedChunkHeader header;
+	if (size < sizeof(header)) corrupt("truncated header");
+	std::memcpy(&header, chunk, sizeof(header));
+	if (header.filter > FilterShuffleDelta) corrupt("unknown filter");
+	if (header.element_size == 0 || header.block_size == 0 || header.block_size % header.element_size != 0) corrupt("bad block size");
+	if (header.block_count != (header.size + header.block_size - 1) / header.block_size) corrupt("bad block count");
+	if ((size - sizeof(header)) / sizeof(uint32_t) < header.block_count) corrupt("truncated block table");
+	//(each LZ input byte decodes to at most 255 output bytes, so bigger claims are corrupt; checking here
+	// stops a few bytes of bad header from asking for gigabytes of output)
+	if (header.size / 256 > size) corrupt("decoded size is larger than the data can hold");
+	return header;
+}
+
+size_t decompressed_size(void const *chunk, size_t size) {
+	return size_t(read_header(chunk, size).size);
+}
+
+void decompress_chunk(void const *chunk, size_t size, void *out_, size_t out_size) {
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(chunk);
+	uint8_t *out = reinterpret_cast< uint8_t * >(out_);
+	CompressedChunkHeader header = read_header(chunk, size);
+	if (header.size != out_size) corrupt("decoded size mismatch");
+
+	//find each block's data:
+	std::vector< uint32_t > sizes(header.block_count);
+	std::memcpy(sizes.data(), data + sizeof(header), sizes.size() * sizeof(uint32_t));
+	std::vector< size_t > offsets(header.block_count);
+	size_t offset = sizeof(header) + sizes.size() * sizeof(uint32_t);
+	for (uint32_t b = 0; b < header.block_count; ++b) {
+		offsets[b] = offset;
+		size_t stored = sizes[b] & ~StoredBlock;
+		if (size - offset < stored) corrupt("block runs past the end");
+		offset += stored;
+	}
+
+	for_each_block(header.block_count, [&](uint32_t b) {
+		size_t begin = size_t(b) * header.block_size;
+		size_t length = std::min< size_t >(header.block_size, out_size - begin);
+		size_t stored = sizes[b] & ~StoredBlock;
+		if (sizes[b] & StoredBlock) {
+			if (stored != length) corrupt("stored block size mismatch");
+			std::memcpy(out + begin, data + offsets[b], length);
+		} else {
+			lz_decompress(data + offsets[b], stored, out + begin, length);
+		}
+		std::vector< uint8_t > scratch;
+		undo_filter(out + begin, length, header.filter, header.element_size, &scratch);
+	});
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//"Compression" packs blob chunks (see MappedBlob.hpp) with a small LZ77 codec:
+//
+// lz_compress() / lz_decompress() handle one block, in the LZ4 block layout: a token byte (literal
+//  length in the high nibble, match length - 4 in the low nibble; 15 means more length bytes follow,
+//  each adding up to 255), the literals, then a two-byte little-endian offset back into the output
+//  (omitted after the final literals). Compression is greedy with one hash probe per position, which
+//  favours decoding speed over ratio.
+//
+// compress_chunk() splits data into blocks of 'block_size' bytes that decode independently (so
+//  decompress_chunk() runs them in parallel), and first applies a filter to each block:
+//  - FilterShuffle regroups the bytes of 'element_size'-byte elements by position (all first bytes,
+//    then all second bytes, ...), so slowly-varying fields of vertex structs line up;
+//  - FilterShuffleDelta also stores each shuffled byte as the difference from the one before, which
+//    turns smooth sequences (quantized positions, mostly-increasing indices) into runs of small values.
+//  Blocks that don't shrink are stored as-is (after filtering).
+//  FilterAuto tries each filter and keeps whichever compresses smallest (which one wins depends a lot
+//  on the data: shuffle + delta packs index data several times better, but can hurt small vertex sets).
+//
+//Compressed chunk layout: a CompressedChunkHeader, block_count uint32_t's giving the stored size of
+// each block (with StoredBlock set if it is not LZ-compressed), then the blocks back to back.
+
+enum ChunkFilter : uint32_t {
+	FilterNone = 0,
+	FilterShuffle = 1,
+	FilterShuffleDelta = 2,
+	FilterAuto = 0xff, //(only for compress_chunk(); never stored)
+};
+
+struct CompressedChunkHeader {
+	uint64_t size = 0; //decompressed size, in bytes
+	uint32_t block_size = 0; //decompressed bytes per block (a multiple of element_size; the last block may be shorter)
+	uint32_t block_count = 0;
+	uint32_t element_size = 1;
+	uint32_t filter = FilterNone;
+};
+static_assert(sizeof(CompressedChunkHeader) == 24, "CompressedChunkHeader is packed");
+
+static constexpr uint32_t StoredBlock = 0x80000000;
+
+//append an LZ-compressed copy of 'size' bytes to 'out':
+void lz_compress(uint8_t const *data, size_t size, std::vector< uint8_t > *out);
+//decompress exactly 'out_size' bytes:
+// note: will throw if the input is corrupt or doesn't decode to exactly out_size bytes.
+void lz_decompress(uint8_t const *data, size_t size, uint8_t *out, size_t out_size);
+
+//compress a whole chunk (blocks are compressed in parallel):
+std::vector< uint8_t > compress_chunk(void const *data, size_t size, ChunkFilter filter = FilterNone, uint32_t element_size = 1, uint32_t block_size = 256 * 1024);
+
+//decompressed size of a compressed chunk:
+// note: will throw if the header is invalid.
+size_t decompressed_size(void const *chunk, size_t size);
+
+//decompress a chunk into 'out' (decompressed_size() bytes; blocks are decompressed in parallel):
+// note: will throw if the chunk is corrupt.
+void decompress_chunk(void const *chunk, size_t size, void *out, size_t out_size);
@@ -0,0 +1,180 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static GLuint compile_upscale_shader(GLenum type, char const *source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	GLint compile_status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+	if (compile_status != GL_TRUE) {
+		GLint info_log_length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(std::max(1, info_log_length), '\0');
+		glGetShaderInfoLog(shader, info_log.size(), NULL, info_log.data());
+		glDeleteShader(shader);
+		throw std::runtime_error("Failed to compile upscale shader: " + std::string(info_log.data()));
+	}
+	return shader;
+}
+
+DynamicResolution::DynamicResolution(glm::uvec2 const &output_size_, float min_scale_, float max_scale_, double target_ms_)
+	: output_size(output_size_), min_scale(min_scale_), max_scale(max_scale_), target_ms(target_ms_) {
+	if (!(0.0f < min_scale && min_scale <= max_scale)) {
+		throw std::runtime_error("Dynamic resolution scale range must satisfy 0 < min <= max.");
+	}
+	scale = lowest_scale = max_scale;
+	allocated_size = glm::uvec2(
+		std::max(1L, std::lround(output_size.x * max_scale)),
+		std::max(1L, std::lround(output_size.y * max_scale))
+	);
+	render_size = allocated_size;
+
+	{ //offscreen target:
+		glGenTextures(1, &color_tex);
+		glBindTexture(GL_TEXTURE_2D, color_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, allocated_size.x, allocated_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenRenderbuffers(1, &depth_renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, allocated_size.x, allocated_size.y);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_tex, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("Dynamic resolution framebuffer is incomplete.");
+		}
+	}
+
+	{ //upscale program (a single triangle covering the viewport, positions from gl_VertexID):
+		GLuint vertex_shader = compile_upscale_shader(GL_VERTEX_SHADER,
+			"#version 330\n"
+			"out vec2 uv;\n"
+			"void main() {\n"
+			"	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+			"	uv = p;\n"
+			"	gl_Position = vec4(2.0 * p - 1.0, 0.0, 1.0);\n"
+			"}\n"
+		);
+		GLuint fragment_shader = compile_upscale_shader(GL_FRAGMENT_SHADER,
+			"#version 330\n"
+			"uniform sampler2D tex;\n"
+			"uniform vec2 uv_max;\n" //edge of the rendered region in texture coordinates
+			"uniform vec2 texel;\n"
+			"uniform float sharpness;\n"
+			"in vec2 uv;\n"
+			"out vec4 fragColor;\n"
+			//clamp so bilinear taps never reach outside the rendered region:
+			"vec4 fetch(vec2 at) { return texture(tex, clamp(at, 0.5 * texel, uv_max - 0.5 * texel)); }\n"
+			"void main() {\n"
+			"	vec2 at = uv * uv_max;\n"
+			"	vec4 color = fetch(at);\n"
+			"	if (sharpness > 0.0) {\n"
+			"		vec4 blur = 0.25 * (\n"
+			"			fetch(at + vec2(texel.x, 0.0)) + fetch(at - vec2(texel.x, 0.0))\n"
+			"			+ fetch(at + vec2(0.0, texel.y)) + fetch(at - vec2(0.0, texel.y)));\n"
+			"		color = clamp(color + sharpness * (color - blur), 0.0, 1.0);\n"
+			"	}\n"
+			"	fragColor = color;\n"
+			"}\n"
+		);
+		program = glCreateProgram();
+		glAttachShader(program, vertex_shader);
+		glAttachShader(program, fragment_shader);
+		glLinkProgram(program);
+		glDeleteShader(vertex_shader);
+		glDeleteShader(fragment_shader);
+		GLint link_status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+		if (link_status != GL_TRUE) {
+			throw std::runtime_error("Failed to link upscale program.");
+		}
+
+		program_tex = glGetUniformLocation(program, "tex");
+		if (program_tex == -1U) throw std::runtime_error("no uniform named tex");
+		program_uv_max = glGetUniformLocation(program, "uv_max");
+		if (program_uv_max == -1U) throw std::runtime_error("no uniform named uv_max");
+		program_texel = glGetUniformLocation(program, "texel");
+		if (program_texel == -1U) throw std::runtime_error("no uniform named texel");
+		program_sharpness = glGetUniformLocation(program, "sharpness");
+		if (program_sharpness == -1U) throw std::runtime_error("no uniform named sharpness");
+
+		//core profile won't draw without a vertex array object, even an empty one:
+		glGenVertexArrays(1, &empty_vao);
+	}
+}
+
+DynamicResolution::~DynamicResolution() {
+	if (updates) {
+		std::cout << "DynamicResolution: average scale " << scale_sum / updates << " (lowest " << lowest_scale << ") over " << updates << " measurements." << std::endl;
+	}
+	glDeleteVertexArrays(1, &empty_vao);
+	glDeleteProgram(program);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth_renderbuffer);
+	glDeleteTextures(1, &color_tex);
+}
+
+void DynamicResolution::update(double gpu_ms) {
+	if (gpu_ms < 0.0) return;
+	//timer results are noisy, so smooth them a bit before they reach the controller:
+	filtered_ms = (filtered_ms < 0.0 ? gpu_ms : filtered_ms + 0.3 * (gpu_ms - filtered_ms));
+
+	//PID in velocity form: adjusts the scale incrementally, so clamping it doesn't wind up the integral term:
+	error = float((target_ms - filtered_ms) / target_ms);
+	float delta = kp * (error - previous_error) + ki * error + kd * (error - 2.0f * previous_error + previous_error2);
+	previous_error2 = previous_error;
+	previous_error = error;
+	scale = std::min(max_scale, std::max(min_scale, scale + delta));
+
+	render_size = glm::uvec2(
+		std::min(long(allocated_size.x), std::max(1L, std::lround(output_size.x * scale))),
+		std::min(long(allocated_size.y), std::max(1L, std::lround(output_size.y * scale)))
+	);
+
+	++updates;
+	scale_sum += scale;
+	lowest_scale = std::min(lowest_scale, scale);
+}
+
+void DynamicResolution::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, render_size.x, render_size.y);
+}
+
+void DynamicResolution::present(GLuint target) const {
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, output_size.x, output_size.y);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, color_tex);
+	glUniform1i(program_tex, 0);
+	glUniform2f(program_uv_max, float(render_size.x) / allocated_size.x, float(render_size.y) / allocated_size.y);
+	glUniform2f(program_texel, 1.0f / allocated_size.x, 1.0f / allocated_size.y);
+	glUniform1f(program_sharpness, sharpen ? sharpness : 0.0f);
+
+	glBindVertexArray(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
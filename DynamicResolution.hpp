@@ -0,0 +1,61 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+//"DynamicResolution" renders the scene into an offscreen target whose resolution follows the GPU load:
+// a PID controller compares measured GPU frame times (e.g., from FrameTimer) against a target and
+// scales the render resolution between min_scale and max_scale (per axis) to keep frame time steady.
+// present() then upscales the rendered region to the output, bilinear or with a light sharpening pass.
+//
+// The target is allocated once at max_scale and drawn into with a smaller viewport, so rescaling is free.
+
+struct DynamicResolution {
+	//note: will throw if the offscreen framebuffer or upscale shader can't be created.
+	DynamicResolution(glm::uvec2 const &output_size, float min_scale = 0.5f, float max_scale = 1.0f, double target_ms = 14.0);
+	~DynamicResolution();
+	DynamicResolution(DynamicResolution const &) = delete;
+
+	//feed a new GPU frame time measurement (milliseconds) to the controller:
+	void update(double gpu_ms);
+
+	//bind the offscreen target for drawing (and set the viewport to render_size):
+	void bind() const;
+
+	//upscale the last rendered frame into 'framebuffer' (0 for the window), which is left bound:
+	void present(GLuint framebuffer) const;
+
+	glm::uvec2 output_size;
+	glm::uvec2 render_size; //current resolution (output_size * scale, rounded)
+	float scale = 1.0f;
+	float min_scale, max_scale;
+	double target_ms;
+	bool sharpen = false; //unsharp mask after bilinear upscaling (helps hide low scales)
+	float sharpness = 0.5f;
+
+	//controller gains (per measurement, acting on the fractional error (target - measured) / target):
+	float kp = 0.1f;
+	float ki = 0.05f;
+	float kd = 0.02f;
+
+	//statistics:
+	uint32_t updates = 0;
+	double scale_sum = 0.0;
+	float lowest_scale = 1.0f;
+
+	//internals:
+	glm::uvec2 allocated_size; //output_size * max_scale
+	GLuint framebuffer = 0;
+	GLuint color_tex = 0;
+	GLuint depth_renderbuffer = 0;
+	GLuint program = 0;
+	GLuint program_tex = 0;
+	GLuint program_uv_max = 0;
+	GLuint program_texel = 0;
+	GLuint program_sharpness = 0;
+	GLuint empty_vao = 0;
+	double filtered_ms = -1.0; //smoothed measurement (negative until first update)
+	float error = 0.0f, previous_error = 0.0f, previous_error2 = 0.0f;
+};
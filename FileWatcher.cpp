@@ -0,0 +1,82 @@
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher(std::string const &directory_) : directory(directory_) {
+#ifdef __linux__
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1) {
+		throw std::runtime_error("Failed to start watching '" + directory + "' (inotify_init1 failed).");
+	}
+	if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		close(fd);
+		throw std::runtime_error("Failed to watch '" + directory + "'.");
+	}
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	if (fd != -1) close(fd);
+#endif
+}
+
+void FileWatcher::watch(std::string const &name) {
+	for (auto const &w : watched) {
+		if (w.name == name) return;
+	}
+	watched.emplace_back();
+	watched.back().name = name;
+	watched.back().modified = modified_time(name);
+}
+
+int64_t FileWatcher::modified_time(std::string const &name) const {
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64((directory + "/" + name).c_str(), &info) != 0) return 0;
+#else
+	struct stat info;
+	if (stat((directory + "/" + name).c_str(), &info) != 0) return 0;
+#endif
+	return int64_t(info.st_mtime);
+}
+
+std::vector< std::string > FileWatcher::poll() {
+	std::vector< std::string > changed;
+	auto report = [&](std::string const &name) {
+		bool is_watched = std::any_of(watched.begin(), watched.end(), [&name](Watched const &w){ return w.name == name; });
+		if (is_watched && std::find(changed.begin(), changed.end(), name) == changed.end()) {
+			changed.emplace_back(name);
+		}
+	};
+#ifdef __linux__
+	if (fd != -1) {
+		alignas(inotify_event) char buffer[4096];
+		while (true) {
+			ssize_t got = read(fd, buffer, sizeof(buffer));
+			if (got <= 0) break; //(EAGAIN: nothing more for now)
+			for (char const *at = buffer; at < buffer + got; ) {
+				inotify_event const *event = reinterpret_cast< inotify_event const * >(at);
+				if (event->len) report(event->name);
+				at += sizeof(inotify_event) + event->len;
+			}
+		}
+		return changed;
+	}
+#endif
+	for (auto &w : watched) {
+		int64_t modified = modified_time(w.name);
+		if (modified != w.modified) {
+			w.modified = modified;
+			if (modified != 0) report(w.name);
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//"FileWatcher" reports when files in a directory are rewritten, for reloading assets while the game runs.
+//On Linux it uses inotify (a file counts as changed once it is closed after writing, or renamed into
+// place, so half-written files aren't reported); elsewhere it compares modification times when polled.
+
+struct FileWatcher {
+	//watch files in 'directory':
+	// note: will throw if the directory can't be watched.
+	FileWatcher(std::string const &directory = ".");
+	~FileWatcher();
+	FileWatcher(FileWatcher const &) = delete;
+	FileWatcher &operator=(FileWatcher const &) = delete;
+
+	//report changes to this file (a name in the directory):
+	void watch(std::string const &name);
+
+	//watched files that changed since the last call (each named once, in the order they changed; never blocks):
+	std::vector< std::string > poll();
+
+	//internals:
+	std::string directory;
+	struct Watched {
+		std::string name;
+		int64_t modified = 0; //(for polling)
+	};
+	std::vector< Watched > watched;
+	int fd = -1; //inotify instance (-1 when polling)
+	int64_t modified_time(std::string const &name) const; //(0 if the file is missing)
+};
@@ -0,0 +1,57 @@
+#include "FrameCapture.hpp"
+#include "load_save_png.hpp"
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+
+constexpr uint32_t FrameCapture::MaxQueued;
+
+//encode on every core but the one running the frame loop:
+static uint32_t encoder_threads() {
+	return std::max(1, int32_t(std::thread::hardware_concurrency()) - 1);
+}
+
+FrameCapture::FrameCapture(glm::uvec2 const &size, std::string const &prefix_) : prefix(prefix_), readback(size), encoder(encoder_threads()) {
+	queued = 0;
+	saved_count = 0;
+}
+
+FrameCapture::~FrameCapture() {
+	readback.flush([this](uint64_t frame, uint32_t const *pixels){ encode(frame, pixels); });
+	encoder.wait();
+	std::cout << "FrameCapture: saved " << saved() << " frames, dropped " << dropped() << " (" << readback.dropped << " waiting on readback, " << queue_dropped << " waiting on encoder)." << std::endl;
+}
+
+void FrameCapture::capture(uint64_t frame) {
+	readback.read(frame);
+}
+
+void FrameCapture::update() {
+	readback.poll([this](uint64_t frame, uint32_t const *pixels){ encode(frame, pixels); });
+}
+
+void FrameCapture::encode(uint64_t frame, uint32_t const *pixels) {
+	if (queued >= MaxQueued) {
+		++queue_dropped;
+		return;
+	}
+	++queued;
+
+	//copy out of the mapped buffer (it gets unmapped when this returns):
+	std::shared_ptr< std::vector< uint32_t > > data = std::make_shared< std::vector< uint32_t > >(pixels, pixels + readback.size.x * readback.size.y);
+
+	std::ostringstream filename;
+	filename << prefix << std::setfill('0') << std::setw(6) << frame << ".png";
+
+	glm::uvec2 size = readback.size;
+	std::string name = filename.str();
+	encoder.run([this, data, size, name](){
+		save_png(name, size.x, size.y, data->data(), LowerLeftOrigin);
+		++saved_count;
+		--queued;
+	});
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "AsyncReadback.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <string>
+
+//"FrameCapture" saves frames as PNG files without blocking the frame loop:
+// frames are read back with AsyncReadback and encoded (save_png) on a worker thread.
+// If readback buffers or the encode queue are full, frames are dropped (and counted) instead.
+
+struct FrameCapture {
+	//frames are written to 'prefix' + frame number + ".png":
+	FrameCapture(glm::uvec2 const &size, std::string const &prefix);
+	~FrameCapture(); //note: waits for in-flight frames to be written
+
+	//capture the frame that was just drawn (call before swapping buffers):
+	void capture(uint64_t frame);
+
+	//call once per frame to hand finished readbacks to the encoder:
+	void update();
+
+	bool continuous = false; //capture every frame (main.cpp checks this)
+	uint32_t dropped() const { return readback.dropped + queue_dropped; }
+	uint32_t saved() const { return saved_count; }
+
+	//internals:
+	std::string prefix;
+	AsyncReadback readback;
+	ThreadPool encoder;
+	static constexpr uint32_t MaxQueued = 8; //frames waiting to be encoded
+	std::atomic< uint32_t > queued;
+	std::atomic< uint32_t > saved_count;
+	uint32_t queue_dropped = 0;
+	void encode(uint64_t frame, uint32_t const *pixels);
+};
@@ -0,0 +1,90 @@
+#include "FrameTimer.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+constexpr uint32_t FrameTimer::QueryCount;
+
+FrameTimer::FrameTimer(bool gpu_, bool history_) : gpu(gpu_), history(history_) {
+	for (uint32_t i = 0; i < QueryCount; ++i) {
+		queries[i] = 0;
+		query_sample[i] = -1U;
+	}
+	if (gpu) glGenQueries(QueryCount, queries);
+}
+
+FrameTimer::~FrameTimer() {
+	if (gpu) glDeleteQueries(QueryCount, queries);
+}
+
+void FrameTimer::collect(uint32_t slot, bool wait) {
+	if (query_sample[slot] == -1U) return;
+	if (!wait) {
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available != GL_TRUE) return;
+	}
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+	samples[query_sample[slot]].gpu_ms = double(elapsed) / 1.0e6;
+	latest_gpu_ms = samples[query_sample[slot]].gpu_ms;
+	++gpu_results;
+	query_sample[slot] = -1U;
+}
+
+void FrameTimer::start_sample() {
+	if (history || samples.size() < QueryCount) {
+		samples.emplace_back();
+		current = uint32_t(samples.size() - 1);
+	} else { //(the slot's old query, if any, was collected before this)
+		current = frame % QueryCount;
+		samples[current] = Sample();
+	}
+	samples[current].frame = frame;
+}
+
+void FrameTimer::begin_frame() {
+	if (!gpu) {
+		start_sample();
+		begin_time = std::chrono::high_resolution_clock::now();
+		return;
+	}
+
+	//pick up any results that have arrived:
+	for (uint32_t i = 0; i < QueryCount; ++i) {
+		collect((frame + i) % QueryCount, false);
+	}
+	uint32_t slot = frame % QueryCount;
+	//if the GPU is more than QueryCount frames behind, this will wait:
+	collect(slot, true);
+
+	start_sample();
+	query_sample[slot] = current;
+
+	begin_time = std::chrono::high_resolution_clock::now();
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void FrameTimer::end_frame() {
+	if (gpu) glEndQuery(GL_TIME_ELAPSED);
+	auto end_time = std::chrono::high_resolution_clock::now();
+	samples[current].cpu_ms = std::chrono::duration< double, std::milli >(end_time - begin_time).count();
+	++frame;
+}
+
+void FrameTimer::finish() {
+	for (uint32_t i = 0; i < QueryCount; ++i) {
+		collect((frame + i) % QueryCount, true);
+	}
+}
+
+void FrameTimer::write_csv(std::string const &filename) const {
+	std::ofstream out(filename);
+	if (!out) {
+		throw std::runtime_error("Failed to open '" + filename + "' for writing timings.");
+	}
+	out << "frame,cpu_ms,gpu_ms\n";
+	for (auto const &sample : samples) {
+		out << sample.frame << ',' << sample.cpu_ms << ',' << sample.gpu_ms << '\n';
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//"FrameTimer" records per-frame CPU and GPU times.
+// GPU times come from GL_TIME_ELAPSED queries that are read back a few frames later,
+// so timing doesn't stall the pipeline.
+// note: GL_TIME_ELAPSED queries can't nest, so only one FrameTimer should be active at a time.
+
+struct FrameTimer {
+	//gpu = false records CPU times only (makes no OpenGL calls);
+	// history = false keeps just the last QueryCount samples (enough for latest_gpu_ms, e.g. to drive
+	// dynamic resolution for a whole session without growing):
+	FrameTimer(bool gpu = true, bool history = true);
+	~FrameTimer();
+	FrameTimer(FrameTimer const &) = delete;
+
+	//bracket the work of one frame:
+	void begin_frame();
+	void end_frame();
+
+	//read back all outstanding query results (waits for the GPU; call before using 'samples' at exit):
+	void finish();
+
+	//write samples as CSV (frame,cpu_ms,gpu_ms):
+	// note: will throw if file fails to open.
+	void write_csv(std::string const &filename) const;
+
+	struct Sample {
+		uint32_t frame = 0;
+		double cpu_ms = 0.0; //time between begin_frame() and end_frame() on the CPU
+		double gpu_ms = -1.0; //GPU time for commands issued in that interval (negative until known)
+	};
+	std::vector< Sample > samples; //every frame, in order (or, without history, a ring indexed by frame % QueryCount)
+
+	//most recent GPU frame time that has come back from the GPU (negative if none yet):
+	double latest_gpu_ms = -1.0;
+	uint32_t gpu_results = 0; //count of GPU times read back so far (lets callers notice new results)
+
+	//internals:
+	bool gpu;
+	bool history;
+	uint32_t current = 0; //index into samples of the frame being timed
+	static constexpr uint32_t QueryCount = 4; //frames of latency allowed for query results
+	GLuint queries[QueryCount];
+	uint32_t query_sample[QueryCount]; //index into samples, or -1U if query slot is idle
+	uint32_t frame = 0;
+	std::chrono::high_resolution_clock::time_point begin_time;
+	void collect(uint32_t slot, bool wait);
+	void start_sample();
+};
@@ -0,0 +1,147 @@
+#include "GeometryArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+constexpr size_t RangeAllocator::Invalid;
+
+RangeAllocator::RangeAllocator(size_t capacity_) {
+	grow(capacity_);
+}
+
+size_t RangeAllocator::allocate(size_t size, size_t alignment) {
+	assert(alignment && (alignment & (alignment - 1)) == 0);
+	if (size == 0) size = 1; //(every allocation gets a distinct offset)
+	for (auto f = free_ranges.begin(); f != free_ranges.end(); ++f) {
+		size_t begin = f->first;
+		size_t end = f->first + f->second;
+		size_t offset = (begin + alignment - 1) & ~(alignment - 1);
+		if (offset + size > end) continue;
+
+		//split off whatever is left before and after the new range:
+		free_ranges.erase(f);
+		if (begin < offset) free_ranges[begin] = offset - begin;
+		if (offset + size < end) free_ranges[offset + size] = end - (offset + size);
+		used += size;
+		return offset;
+	}
+	return Invalid;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+	if (size == 0) size = 1;
+	assert(offset + size <= capacity);
+	used -= size;
+
+	auto next = free_ranges.lower_bound(offset);
+	assert(next == free_ranges.end() || next->first >= offset + size);
+	//merge with the following free range:
+	if (next != free_ranges.end() && next->first == offset + size) {
+		size += next->second;
+		next = free_ranges.erase(next);
+	}
+	//merge with the preceding free range:
+	if (next != free_ranges.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset);
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+	free_ranges[offset] = size;
+}
+
+void RangeAllocator::grow(size_t new_capacity) {
+	if (new_capacity <= capacity) return;
+	size_t begin = capacity;
+	size_t size = new_capacity - capacity;
+	capacity = new_capacity;
+	used += size; //(free() subtracts it again)
+	free(begin, size);
+}
+
+GeometryArena::GeometryArena(size_t vertex_stride_, std::function< void() > const &set_attributes_, size_t vertex_capacity, size_t index_capacity)
+	: vertex_stride(vertex_stride_), set_attributes(set_attributes_), vertices(vertex_capacity), indices(index_capacity) {
+	if (vertex_stride == 0 || (vertex_stride & (vertex_stride - 1)) != 0) {
+		throw std::runtime_error("GeometryArena vertex stride (" + std::to_string(vertex_stride) + ") must be a power of two.");
+	}
+	GLuint buffers[2] = {0, 0};
+	glGenBuffers(2, buffers);
+	vertex_buffer = buffers[0];
+	index_buffer = buffers[1];
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, index_capacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glGenVertexArrays(1, &vao);
+	bind_vao();
+}
+
+GeometryArena::~GeometryArena() {
+	glDeleteVertexArrays(1, &vao);
+	GLuint buffers[2] = {vertex_buffer, index_buffer};
+	glDeleteBuffers(2, buffers);
+}
+
+void GeometryArena::bind_vao() {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	set_attributes();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::Range GeometryArena::allocate(RangeAllocator &allocator, GLuint *buffer, size_t bytes, size_t alignment, char const *what) {
+	Range range;
+	range.size = bytes;
+	range.offset = allocator.allocate(bytes, alignment);
+	if (range.offset != RangeAllocator::Invalid) return range;
+
+	//double the buffer until the range fits at the end (in the worst case, after the last used byte):
+	size_t old_capacity = allocator.capacity;
+	size_t new_capacity = std::max< size_t >(old_capacity, 1024);
+	while (new_capacity < old_capacity + bytes + alignment) new_capacity *= 2;
+
+	GLuint grown = 0;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, NULL, GL_STATIC_DRAW);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_capacity);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, buffer);
+	*buffer = grown;
+	bind_vao();
+
+	allocator.grow(new_capacity);
+	std::cout << "GeometryArena: grew " << what << " buffer from " << old_capacity << " to " << new_capacity << " bytes." << std::endl;
+
+	range.offset = allocator.allocate(bytes, alignment);
+	assert(range.offset != RangeAllocator::Invalid);
+	return range;
+}
+
+GeometryArena::Range GeometryArena::allocate_vertices(size_t bytes) {
+	return allocate(vertices, &vertex_buffer, bytes, vertex_stride, "vertex");
+}
+
+GeometryArena::Range GeometryArena::allocate_indices(size_t bytes) {
+	return allocate(indices, &index_buffer, bytes, 4, "index");
+}
+
+void GeometryArena::free_vertices(Range const &range) {
+	vertices.free(range.offset, range.size);
+}
+
+void GeometryArena::free_indices(Range const &range) {
+	indices.free(range.offset, range.size);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <functional>
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+
+//"RangeAllocator" hands out ranges of [0, capacity): a first-fit free list, ordered by offset,
+// that merges neighbouring free ranges when ranges are freed.
+struct RangeAllocator {
+	static constexpr size_t Invalid = size_t(-1);
+
+	RangeAllocator(size_t capacity = 0);
+
+	//offset of a new range ('alignment' must be a power of two), or Invalid if there is no room:
+	size_t allocate(size_t size, size_t alignment);
+	//return a range (as given to / returned from allocate()):
+	void free(size_t offset, size_t size);
+	//add [capacity, new_capacity) to the free list:
+	void grow(size_t new_capacity);
+
+	size_t capacity = 0;
+	size_t used = 0; //bytes in allocated ranges (not counting alignment padding)
+	std::map< size_t, size_t > free_ranges; //offset -> size
+};
+
+//"GeometryArena" holds the vertex and index data of many meshes (from any number of files) in one
+// vertex buffer and one index buffer, with a single vertex array object that reads them, so drawing
+// meshes from different files needs no VAO switches (draws pick their data with index offsets and
+// base vertices).
+//
+//Ranges are sub-allocated with RangeAllocator; when one doesn't fit, the buffer doubles (the old
+// contents are copied over on the GPU, and the VAO is pointed at the new buffer with 'set_attributes').
+// Buffer names change when that happens, so read vertex_buffer / index_buffer when uploading.
+
+struct GeometryArena {
+	//'set_attributes' is called with the VAO and vertex buffer bound, to set up the vertex format:
+	// note: will throw if vertex_stride isn't a power of two (vertex ranges are aligned to whole vertices).
+	GeometryArena(size_t vertex_stride, std::function< void() > const &set_attributes, size_t vertex_capacity = 4 << 20, size_t index_capacity = 1 << 20);
+	~GeometryArena(); //(needs the GL context)
+	GeometryArena(GeometryArena const &) = delete;
+
+	struct Range {
+		size_t offset = 0; //in bytes
+		size_t size = 0;
+	};
+	//vertex ranges start on a whole vertex; index ranges on a 4-byte boundary (so 16- and 32-bit indices can share);
+	// may grow (and so rename) the buffer:
+	Range allocate_vertices(size_t bytes);
+	Range allocate_indices(size_t bytes);
+	void free_vertices(Range const &range);
+	void free_indices(Range const &range);
+
+	size_t vertex_stride;
+	std::function< void() > set_attributes;
+	GLuint vao = 0;
+	GLuint vertex_buffer = 0;
+	GLuint index_buffer = 0;
+	RangeAllocator vertices;
+	RangeAllocator indices;
+
+	//internals:
+	Range allocate(RangeAllocator &allocator, GLuint *buffer, size_t bytes, size_t alignment, char const *what);
+	void bind_vao();
+};
@@ -0,0 +1,126 @@
+#include "Headless.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+HeadlessContext::HeadlessContext(glm::uvec2 const &size_) : size(size_) {
+	EGLDisplay egl_display = EGL_NO_DISPLAY;
+
+	{ //prefer the surfaceless platform (no X / wayland / drm device needed):
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display) {
+			egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		}
+		EGLint major = 0, minor = 0;
+		if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+			egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+				throw std::runtime_error("Failed to initialize an EGL display.");
+			}
+		}
+		std::cout << "Headless: EGL " << major << "." << minor << std::endl;
+	}
+	display = egl_display;
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		throw std::runtime_error("EGL display does not support desktop OpenGL.");
+	}
+
+	EGLint const config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(egl_display, config_attribs, &config, 1, &config_count) || config_count == 0) {
+		config = nullptr; //surfaceless contexts can get by without a config
+	}
+
+	EGLint const context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attribs);
+	if (egl_context == EGL_NO_CONTEXT) {
+		eglTerminate(egl_display);
+		throw std::runtime_error("Failed to create an OpenGL 3.3 core context with EGL.");
+	}
+	context = egl_context;
+
+	//all rendering goes to the framebuffer below, so only make a (tiny) surface if surfaceless isn't supported:
+	EGLSurface egl_surface = EGL_NO_SURFACE;
+	if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+		EGLint const pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		if (config) egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attribs);
+		if (egl_surface == EGL_NO_SURFACE || !eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
+			eglDestroyContext(egl_display, egl_context);
+			eglTerminate(egl_display);
+			throw std::runtime_error("Failed to make headless EGL context current.");
+		}
+	}
+	surface = egl_surface;
+
+	std::cout << "Headless: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+
+	//build offscreen render target:
+	glGenRenderbuffers(1, &color_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+
+	glGenRenderbuffers(1, &depth_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Headless framebuffer is incomplete (status " + std::to_string(status) + ").");
+	}
+}
+
+HeadlessContext::~HeadlessContext() {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	glDeleteRenderbuffers(1, &color_renderbuffer);
+	color_renderbuffer = 0;
+	glDeleteRenderbuffers(1, &depth_renderbuffer);
+	depth_renderbuffer = 0;
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	surface = context = display = nullptr;
+}
+
+#else //no EGL on this platform
+
+HeadlessContext::HeadlessContext(glm::uvec2 const &size_) : size(size_) {
+	throw std::runtime_error("Headless rendering is only supported on Linux (EGL).");
+}
+
+HeadlessContext::~HeadlessContext() {
+}
+
+#endif
+
+void HeadlessContext::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, size.x, size.y);
+}
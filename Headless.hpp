@@ -0,0 +1,30 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+//"HeadlessContext" creates an OpenGL 3.3 core context without a window (via EGL, surfaceless
+// if the driver supports it, otherwise a tiny pbuffer) along with an offscreen framebuffer to draw into.
+// This makes it possible to run benchmarks and tests on display-less machines (e.g., Mesa's llvmpipe).
+// note: constructor will throw if a context can't be created (or on platforms without EGL).
+
+struct HeadlessContext {
+	HeadlessContext(glm::uvec2 const &size);
+	~HeadlessContext();
+	HeadlessContext(HeadlessContext const &) = delete;
+
+	//bind the offscreen framebuffer for drawing (and set the viewport to cover it):
+	void bind() const;
+
+	glm::uvec2 size;
+
+	//offscreen render target:
+	GLuint framebuffer = 0;
+	GLuint color_renderbuffer = 0;
+	GLuint depth_renderbuffer = 0;
+
+	//internals (EGL handles, stored as void * to keep EGL headers out of the rest of the code):
+	void *display = nullptr;
+	void *surface = nullptr;
+	void *context = nullptr;
+};
@@ -0,0 +1,338 @@
+#include "MappedBlob.hpp"
+#include "Checksum.hpp"
+#include "Compression.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr uint32_t MappedBlob::Version;
+
+#ifdef MAPPEDBLOB_TRUSTED
+bool MappedBlob::verify_checksums = false;
+#else
+bool MappedBlob::verify_checksums = true;
+#endif
+
+struct MappedBlob::Checks {
+	enum : uint32_t { Queued, Running, Done, Cancelled };
+	struct Check {
+		uint32_t index = 0;
+		std::atomic< uint32_t > state;
+		bool ok = false;
+		Check(uint32_t index_) : index(index_), state(Queued) { }
+	};
+	std::list< std::shared_ptr< Check > > list; //(only touched by the blob's thread; jobs share their entries, which outlive a wait)
+	std::mutex mutex;
+	std::condition_variable done_cv; //signalled when a check is Done
+
+	//run a check unless it has already been claimed (by a worker, wait_verified(), or the destructor):
+	static void run(std::shared_ptr< Checks > const &checks, std::shared_ptr< Check > const &check, char const *at, size_t size, uint32_t crc) {
+		uint32_t expected = Queued;
+		if (!check->state.compare_exchange_strong(expected, Running)) return;
+		bool ok = (crc32c(at, size) == crc);
+		std::unique_lock< std::mutex > lock(checks->mutex);
+		check->ok = ok;
+		check->state = Done;
+		checks->done_cv.notify_all();
+	}
+	void wait() {
+		std::unique_lock< std::mutex > lock(mutex);
+		done_cv.wait(lock, [this](){
+			for (auto const &check : list) {
+				if (check->state == Running) return false;
+			}
+			return true;
+		});
+	}
+};
+
+MappedBlob::MappedBlob(std::string const &filename_) : filename(filename_) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "'.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get the size of '" + filename + "'.");
+	}
+	size = size_t(file_size.QuadPart);
+	file_handle = file;
+	if (size != 0) { //(empty files can't be mapped)
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			unmap();
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		mapping_handle = mapping;
+		data = reinterpret_cast< char const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			unmap();
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error("Failed to open '" + filename + "'.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get the size of '" + filename + "'.");
+	}
+	size = size_t(info.st_size);
+	if (size != 0) { //(empty files can't be mapped)
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		data = reinterpret_cast< char const * >(mapped);
+	}
+	close(fd); //(the mapping keeps the file open)
+#endif
+
+	try {
+		index_chunks();
+	} catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+MappedBlob::MappedBlob(std::string const &name, char const *data_, size_t size_) : filename(name), data(size_ ? data_ : nullptr), size(size_), view(true) {
+	index_chunks();
+}
+
+MappedBlob::~MappedBlob() {
+	if (checks) {
+		//drop checks nobody has started, and let running ones finish with the mapping:
+		for (auto &check : checks->list) {
+			uint32_t expected = Checks::Queued;
+			check->state.compare_exchange_strong(expected, Checks::Cancelled);
+		}
+		checks->wait();
+	}
+	unmap();
+}
+
+void MappedBlob::unmap() {
+	if (view) {
+		data = nullptr;
+		return;
+	}
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	mapping_handle = file_handle = nullptr;
+#else
+	if (data) munmap(const_cast< char * >(data), size);
+#endif
+	data = nullptr;
+}
+
+void MappedBlob::index_chunks() {
+	BlobHeader header;
+	if (size >= sizeof(header) && std::memcmp(data, header.magic, 4) == 0) {
+		//versioned: check the header and table of contents (chunk data is checked when it is used):
+		std::memcpy(&header, data, sizeof(header));
+		if (header.version == 0 || header.version > Version) {
+			throw std::runtime_error("'" + filename + "' is blob version " + std::to_string(header.version) + ", but only versions up to " + std::to_string(Version) + " can be read.");
+		}
+		version = header.version;
+		if ((size - sizeof(header)) / sizeof(BlobTocEntry) < header.chunk_count) {
+			throw std::runtime_error("Table of contents of '" + filename + "' is truncated.");
+		}
+		size_t toc_size = header.chunk_count * sizeof(BlobTocEntry);
+#ifndef BLOB_FUZZER //(fuzzed tables of contents should reach the checks below)
+		if (crc32c(data + sizeof(header), toc_size) != header.toc_crc) {
+			throw std::runtime_error("Table of contents of '" + filename + "' is corrupt (checksum mismatch).");
+		}
+#endif
+		chunks.resize(header.chunk_count);
+		for (uint32_t i = 0; i < header.chunk_count; ++i) {
+			BlobTocEntry &entry = chunks[i].entry;
+			std::memcpy(&entry, data + sizeof(header) + i * sizeof(BlobTocEntry), sizeof(BlobTocEntry));
+			std::string magic(entry.magic, 4);
+			if (entry.alignment == 0 || (entry.alignment & (entry.alignment - 1)) != 0 || entry.offset % entry.alignment != 0) {
+				throw std::runtime_error("Chunk '" + magic + "' of '" + filename + "' has a bad alignment.");
+			}
+			if (entry.offset < sizeof(header) + toc_size || entry.offset > size || size - entry.offset < entry.size) {
+				throw std::runtime_error("Chunk '" + magic + "' of '" + filename + "' is out of range.");
+			}
+			if ((entry.flags & ~BlobChunkCompressed) != 0) {
+				throw std::runtime_error("Chunk '" + magic + "' of '" + filename + "' uses unsupported features (flags " + std::to_string(entry.flags) + ").");
+			}
+		}
+		return;
+	}
+
+	//unversioned: walk the chunk headers (problems are reported when the chunks are read):
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0' };
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+	size_t offset = 0;
+	while (size - offset >= sizeof(ChunkHeader)) {
+		ChunkHeader chunk_header;
+		std::memcpy(&chunk_header, data + offset, sizeof(chunk_header));
+		chunks.emplace_back();
+		Chunk &chunk = chunks.back();
+		std::memcpy(chunk.entry.magic, chunk_header.magic, 4);
+		chunk.entry.alignment = 1;
+		chunk.entry.offset = offset + sizeof(chunk_header);
+		chunk.entry.size = chunk_header.size;
+		chunk.verified = true; //(nothing to check against)
+		if (size - chunk.entry.offset < chunk_header.size) {
+			chunk.truncated = true;
+			offset = size;
+			break;
+		}
+		offset = chunk.entry.offset + chunk_header.size;
+	}
+	trailing_bytes = size - offset;
+}
+
+bool MappedBlob::has_chunk(std::string const &magic) const {
+	return find(magic) != -1U;
+}
+
+uint32_t MappedBlob::find(std::string const &magic) const {
+	for (uint32_t i = 0; i < chunks.size(); ++i) {
+		if (std::string(chunks[i].entry.magic, 4) == magic) return i;
+	}
+	return -1U;
+}
+
+uint32_t MappedBlob::find_required(std::string const &magic) const {
+	uint32_t index = find(magic);
+	if (index == -1U) {
+		if (trailing_bytes != 0) {
+			throw std::runtime_error("Missing chunk '" + magic + "' in '" + filename + "' (the file is truncated: it ends with " + std::to_string(trailing_bytes) + " bytes of an incomplete chunk header).");
+		}
+		throw std::runtime_error("Missing chunk '" + magic + "' in '" + filename + "'.");
+	}
+	return index;
+}
+
+char const *MappedBlob::chunk_data(uint32_t index, size_t element_size, size_t element_align, size_t *count) {
+	Chunk &chunk = chunks[index];
+	if (chunk.entry.flags & BlobChunkCompressed) return decompressed_data(index, element_size, count);
+	if (chunk.truncated) {
+		throw std::runtime_error(describe(index) + " is truncated (" + std::to_string(size - chunk.entry.offset) + " of " + std::to_string(chunk.entry.size) + " bytes are present).");
+	}
+	if (chunk.entry.size % element_size != 0) {
+		throw std::runtime_error(describe(index) + " is " + std::to_string(chunk.entry.size) + " bytes, which is not a whole number of " + std::to_string(element_size) + "-byte elements.");
+	}
+	char const *at = data + chunk.entry.offset;
+	size_t bytes = size_t(chunk.entry.size);
+	verify(index);
+	*count = bytes / element_size;
+
+	if (bytes == 0) return nullptr;
+	if (reinterpret_cast< uintptr_t >(at) % element_align != 0) {
+		static_assert(sizeof(uint64_t) >= alignof(double), "aligned copies are made in uint64_t storage");
+		aligned_copies.emplace_back((bytes + 7) / 8);
+		std::memcpy(aligned_copies.back().data(), at, bytes);
+		++copied_chunks;
+		return reinterpret_cast< char const * >(aligned_copies.back().data());
+	}
+	return at;
+}
+
+std::string MappedBlob::describe(uint32_t index) const {
+	return "Chunk '" + std::string(chunks[index].entry.magic, 4) + "' of '" + filename + "'";
+}
+
+void MappedBlob::verify(uint32_t index) {
+	Chunk &chunk = chunks[index];
+	if (chunk.verified || chunk.checking) return;
+	if (!verify_checksums) {
+		chunk.verified = true;
+		return;
+	}
+	char const *at = data + chunk.entry.offset;
+	size_t bytes = size_t(chunk.entry.size);
+	if (verify_pool) {
+		if (!checks) checks = std::make_shared< Checks >();
+		checks->list.emplace_back(std::make_shared< Checks::Check >(index));
+		std::shared_ptr< Checks::Check > check = checks->list.back();
+		std::shared_ptr< Checks > shared = checks;
+		uint32_t crc = chunk.entry.crc;
+		verify_pool->run([shared, check, at, bytes, crc](){
+			Checks::run(shared, check, at, bytes, crc);
+		});
+		chunk.checking = true;
+		return;
+	}
+	if (crc32c(at, bytes) != chunk.entry.crc) {
+		throw std::runtime_error(describe(index) + " is corrupt (checksum mismatch).");
+	}
+	chunk.verified = true;
+}
+
+void MappedBlob::wait_verified() {
+	if (!checks) return;
+	//run checks the pool hasn't got to yet here, rather than waiting for a worker:
+	for (auto &check : checks->list) {
+		Checks::run(checks, check, data + chunks[check->index].entry.offset, size_t(chunks[check->index].entry.size), chunks[check->index].entry.crc);
+	}
+	checks->wait();
+
+	std::list< std::shared_ptr< Checks::Check > > finished;
+	finished.swap(checks->list);
+	std::string error;
+	for (auto const &check : finished) {
+		Chunk &chunk = chunks[check->index];
+		chunk.checking = false;
+		if (check->ok) {
+			chunk.verified = true;
+		} else if (error == "") {
+			error = describe(check->index) + " is corrupt (checksum mismatch).";
+		}
+	}
+	if (error != "") throw std::runtime_error(error);
+}
+
+char const *MappedBlob::decompressed_data(uint32_t index, size_t element_size, size_t *count) {
+	Chunk &chunk = chunks[index];
+	std::string magic(chunk.entry.magic, 4);
+	if (!chunk.decompressed) {
+		verify(index); //(the decoder is bounds-checked, so it's fine for it to run while a background check does)
+		char const *at = data + chunk.entry.offset;
+		size_t stored = size_t(chunk.entry.size);
+		try {
+			chunk.decompressed_size = ::decompressed_size(at, stored);
+			aligned_copies.emplace_back((chunk.decompressed_size + 7) / 8);
+			decompress_chunk(at, stored, aligned_copies.back().data(), chunk.decompressed_size);
+		} catch (std::exception &e) {
+			throw std::runtime_error("Chunk '" + magic + "' of '" + filename + "' failed to decompress: " + e.what());
+		}
+		chunk.decompressed = reinterpret_cast< char const * >(aligned_copies.back().data());
+		++decompressed_chunks;
+	}
+	if (chunk.decompressed_size % element_size != 0) {
+		throw std::runtime_error(describe(index) + " decompresses to " + std::to_string(chunk.decompressed_size) + " bytes, which is not a whole number of " + std::to_string(element_size) + "-byte elements.");
+	}
+	*count = chunk.decompressed_size / element_size;
+	return (chunk.decompressed_size ? chunk.decompressed : nullptr);
+}
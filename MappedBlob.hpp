@@ -0,0 +1,148 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+//"MappedBlob" maps a chunk file into memory and hands out views of its chunks that point straight
+// into the mapping, so data can go from the page cache to wherever it is needed (e.g. glBufferData)
+// without an intermediate copy.
+//
+//Two file formats are understood:
+// - unversioned files are a sequence of chunks, each an 8-byte header (magic, size) followed by
+//   the data (the format read by read_chunk() and written by write_chunk());
+// - versioned files (written by BlobWriter) start with a BlobHeader and a table of contents
+//   (one BlobTocEntry per chunk), so chunks can be found without reading the ones before them;
+//   every chunk's data is aligned as its entry says and has a CRC-32C (see Checksum.hpp);
+//   chunks flagged BlobChunkCompressed hold a compressed chunk (see Compression.hpp), which is
+//   decompressed into storage owned by the blob (counted in 'decompressed_chunks') when first found.
+//
+//find_chunk() looks chunks up by magic in either format, so they may come in any order
+// (the first chunk with a magic wins; chunks nobody asks for are never touched).
+//
+//Data in unversioned files is only aligned if the chunks before it happen to have aligned sizes;
+// a chunk that isn't aligned for its element type is copied into storage owned by the blob
+// (counted in 'copied_chunks').
+//
+//Chunk checksums are checked the first time a chunk is found. With 'verify_pool' set, the check
+// runs there instead, so the caller can get on with the data while it happens; wait_verified()
+// finishes any such checks (running leftover ones itself) and throws if one failed, so call it
+// before trusting the data (e.g., before uploading it).
+//Builds that only ever read files they made themselves can define MAPPEDBLOB_TRUSTED (or clear
+// MappedBlob::verify_checksums) to skip chunk checks; the table of contents is always checked
+// (except in fuzzing builds, see blob_bench.cpp).
+
+struct ThreadPool;
+
+//read-only view of 'size' elements of T:
+template< typename T >
+struct BlobSpan {
+	T const *data = nullptr;
+	size_t size = 0;
+
+	BlobSpan() = default;
+	BlobSpan(T const *data_, size_t size_) : data(data_), size(size_) { }
+	//view a whole vector (stays valid until the vector is resized):
+	BlobSpan(std::vector< T > const &from) : data(from.data()), size(from.size()) { }
+
+	bool empty() const { return size == 0; }
+	T const *begin() const { return data; }
+	T const *end() const { return data + size; }
+	T const &operator[](size_t i) const { return data[i]; }
+};
+
+//versioned file layout:
+struct BlobHeader {
+	char magic[4] = {'b', 'l', 'o', 'b'};
+	uint32_t version = 1;
+	uint32_t chunk_count = 0; //number of BlobTocEntry's right after this header
+	uint32_t toc_crc = 0; //CRC-32C of the BlobTocEntry's
+};
+static_assert(sizeof(BlobHeader) == 16, "BlobHeader is packed");
+
+struct BlobTocEntry {
+	char magic[4] = {'\0', '\0', '\0', '\0'};
+	uint32_t alignment = 16; //offset is a multiple of this (a power of two)
+	uint64_t offset = 0; //from the start of the file
+	uint64_t size = 0; //in bytes
+	uint32_t crc = 0; //CRC-32C of the data
+	uint32_t flags = 0; //BlobChunk* bits (readers reject chunks with unknown flags); crc covers the data as stored
+};
+static_assert(sizeof(BlobTocEntry) == 32, "BlobTocEntry is packed");
+
+static constexpr uint32_t BlobChunkCompressed = 1;
+
+struct MappedBlob {
+	//newest versioned format this code reads:
+	static constexpr uint32_t Version = 1;
+
+	//check chunk CRCs? (defaults to true, or false if MAPPEDBLOB_TRUSTED is defined):
+	static bool verify_checksums;
+
+	//map a file for reading:
+	// note: will throw if the file can't be opened or mapped, or if its table of contents is invalid.
+	MappedBlob(std::string const &filename);
+	//view a blob that is already in memory (which must outlive this; 'name' is used in messages):
+	// note: will throw if its table of contents is invalid.
+	MappedBlob(std::string const &name, char const *data, size_t size);
+	~MappedBlob();
+	MappedBlob(MappedBlob const &) = delete;
+	MappedBlob &operator=(MappedBlob const &) = delete;
+
+	//is there a chunk with this magic?
+	bool has_chunk(std::string const &magic) const;
+
+	//view the data of the first chunk with this magic:
+	// note: will throw if there is no such chunk, it is truncated, its checksum doesn't match, or it isn't a whole number of elements.
+	//  (with verify_pool set, checksum mismatches are reported by wait_verified() instead)
+	template< typename T >
+	BlobSpan< T > find_chunk(std::string const &magic) {
+		size_t count = 0;
+		char const *at = chunk_data(find_required(magic), sizeof(T), alignof(T), &count);
+		return BlobSpan< T >(reinterpret_cast< T const * >(at), count);
+	}
+
+	//wait for chunk checks running on verify_pool:
+	// note: will throw if any chunk found so far has a checksum mismatch.
+	void wait_verified();
+
+	std::string filename;
+	ThreadPool *verify_pool = nullptr; //if set, check chunks here (see above)
+	char const *data = nullptr; //(nullptr for an empty file)
+	size_t size = 0;
+	uint32_t version = 0; //0 for unversioned files
+	size_t trailing_bytes = 0; //bytes after the last whole chunk of an unversioned file
+	uint32_t copied_chunks = 0;
+	uint32_t decompressed_chunks = 0;
+	bool view = false; //(viewing memory; nothing to unmap)
+
+	//internals:
+	struct Chunk {
+		BlobTocEntry entry;
+		bool verified = false;
+		bool checking = false; //(queued on verify_pool)
+		bool truncated = false; //(unversioned files only: the header fits, but not the data)
+		char const *decompressed = nullptr; //(compressed chunks, once found)
+		size_t decompressed_size = 0;
+	};
+	std::vector< Chunk > chunks; //in file order (for unversioned files, found by walking the headers)
+	std::list< std::vector< uint64_t > > aligned_copies;
+	struct Checks; //chunk checks on verify_pool (shared with the jobs, which may outlive a wait)
+	std::shared_ptr< Checks > checks;
+
+	void index_chunks();
+	void unmap();
+	uint32_t find(std::string const &magic) const; //-1U if missing
+	uint32_t find_required(std::string const &magic) const; //throws if missing
+	char const *chunk_data(uint32_t index, size_t element_size, size_t element_align, size_t *count);
+	char const *decompressed_data(uint32_t index, size_t element_size, size_t *count);
+	void verify(uint32_t index); //throws if the checksum doesn't match (or queues the check on verify_pool)
+	std::string describe(uint32_t index) const; //"Chunk 'magic' of 'filename'"
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,249 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+VertexCacheStats analyze_vertex_cache(uint32_t const *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+	VertexCacheStats stats;
+	if (index_count < 3) return stats;
+
+	//FIFO cache simulated with timestamps: a vertex is cached if it was loaded within the last cache_size misses.
+	std::vector< uint32_t > loaded(vertex_count, 0);
+	std::vector< bool > used(vertex_count, false);
+	uint32_t time = cache_size + 1;
+	uint32_t misses = 0;
+	uint32_t distinct = 0;
+	for (uint32_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+		assert(v < vertex_count);
+		if (time - loaded[v] > cache_size) {
+			loaded[v] = time++;
+			++misses;
+		}
+		if (!used[v]) {
+			used[v] = true;
+			++distinct;
+		}
+	}
+	stats.acmr = float(misses) / float(index_count / 3);
+	stats.atvr = float(misses) / float(distinct);
+	return stats;
+}
+
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size, std::vector< uint32_t > *clusters) {
+	uint32_t triangle_count = index_count / 3;
+	if (clusters) clusters->clear();
+	if (triangle_count == 0) return;
+
+	//vertex -> triangle adjacency:
+	std::vector< uint32_t > live(vertex_count, 0); //triangles not yet emitted that use each vertex
+	for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+		++live[indices[i]];
+	}
+	std::vector< uint32_t > offsets(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	std::vector< uint32_t > adjacency(triangle_count * 3);
+	{
+		std::vector< uint32_t > fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				adjacency[fill[indices[3 * t + k]]++] = t;
+			}
+		}
+	}
+
+	std::vector< uint32_t > cached(vertex_count, 0); //time each vertex entered the cache
+	std::vector< bool > emitted(triangle_count, false);
+	std::vector< uint32_t > dead_end; //recently used vertices, to restart from when fanning runs out
+	std::vector< uint32_t > candidates;
+	std::vector< uint32_t > result;
+	result.reserve(triangle_count * 3);
+	uint32_t time = cache_size + 1;
+	uint32_t cursor = 0; //scan position for finding unfinished vertices
+
+	//next vertex to fan around when there are no good candidates:
+	auto skip_dead_end = [&]() -> uint32_t {
+		while (!dead_end.empty()) {
+			uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live[v] > 0) return v;
+		}
+		while (cursor < vertex_count) {
+			if (live[cursor] > 0) return cursor;
+			++cursor;
+		}
+		return -1U;
+	};
+
+	uint32_t fan = skip_dead_end();
+	while (fan != -1U) {
+		candidates.clear();
+		//emit all remaining triangles around 'fan':
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t]) continue;
+			emitted[t] = true;
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = indices[3 * t + k];
+				result.emplace_back(v);
+				dead_end.emplace_back(v);
+				candidates.emplace_back(v);
+				--live[v];
+				if (time - cached[v] > cache_size) {
+					cached[v] = time++;
+				}
+			}
+		}
+
+		//pick the candidate that will still be in the cache after its remaining triangles are emitted,
+		// preferring the oldest (it would be evicted soonest):
+		uint32_t best = -1U;
+		int32_t best_priority = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) continue;
+			int32_t priority = 0;
+			if (time - cached[v] + 2 * live[v] <= cache_size) {
+				priority = int32_t(time - cached[v]);
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				best = v;
+			}
+		}
+		if (best == -1U) {
+			best = skip_dead_end();
+			if (best != -1U && clusters) {
+				clusters->emplace_back(result.size() / 3);
+			}
+		}
+		fan = best;
+	}
+	assert(result.size() == triangle_count * 3);
+
+	if (clusters && (clusters->empty() || clusters->front() != 0)) {
+		clusters->insert(clusters->begin(), 0);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_overdraw(uint32_t *indices, uint32_t index_count, glm::vec3 const *positions, uint32_t vertex_count,
+	std::vector< uint32_t > const &hard_clusters, uint32_t cache_size, float threshold) {
+	uint32_t triangle_count = index_count / 3;
+	if (triangle_count == 0) return;
+
+	std::vector< uint32_t > cached(vertex_count, 0);
+	uint32_t time = cache_size + 1;
+	auto misses_for = [&](uint32_t t) -> uint32_t {
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t v = indices[3 * t + k];
+			if (time - cached[v] > cache_size) {
+				cached[v] = time++;
+				++misses;
+			}
+		}
+		return misses;
+	};
+	auto flush = [&]() {
+		time += cache_size + 1;
+	};
+
+	//split hard clusters wherever the running ACMR is already within 'threshold' of the whole cluster's ACMR:
+	std::vector< uint32_t > starts;
+	for (uint32_t c = 0; c < hard_clusters.size(); ++c) {
+		uint32_t begin = hard_clusters[c];
+		uint32_t end = (c + 1 < hard_clusters.size() ? hard_clusters[c + 1] : triangle_count);
+		if (begin >= end) continue;
+
+		flush();
+		uint32_t cluster_misses = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			cluster_misses += misses_for(t);
+		}
+		float cluster_threshold = threshold * float(cluster_misses) / float(end - begin);
+
+		flush();
+		starts.emplace_back(begin);
+		uint32_t running_misses = 0, running_triangles = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			running_misses += misses_for(t);
+			running_triangles += 1;
+			if (t + 1 < end && float(running_misses) / float(running_triangles) <= cluster_threshold) {
+				starts.emplace_back(t + 1);
+				flush();
+				running_misses = running_triangles = 0;
+			}
+		}
+	}
+	if (starts.size() <= 1) return;
+
+	//sort clusters by how much they face away from the mesh's center:
+	glm::vec3 center = glm::vec3(0.0f);
+	for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+		center += positions[indices[i]];
+	}
+	center = center / float(triangle_count * 3);
+
+	struct Cluster {
+		uint32_t begin, end;
+		float key;
+	};
+	std::vector< Cluster > sorted;
+	sorted.reserve(starts.size());
+	for (uint32_t c = 0; c < starts.size(); ++c) {
+		Cluster cluster;
+		cluster.begin = starts[c];
+		cluster.end = (c + 1 < starts.size() ? starts[c + 1] : triangle_count);
+
+		glm::vec3 centroid = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = cluster.begin; t < cluster.end; ++t) {
+			glm::vec3 const &a = positions[indices[3 * t + 0]];
+			glm::vec3 const &b = positions[indices[3 * t + 1]];
+			glm::vec3 const &c = positions[indices[3 * t + 2]];
+			glm::vec3 n = glm::cross(b - a, c - a); //length is twice the area
+			float l = glm::length(n);
+			centroid += (a + b + c) * (l / 3.0f);
+			normal += n;
+			area += l;
+		}
+		if (area > 0.0f) centroid = centroid / area;
+		float normal_length = glm::length(normal);
+		if (normal_length > 0.0f) normal = normal / normal_length;
+		cluster.key = glm::dot(centroid - center, normal);
+		sorted.emplace_back(cluster);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](Cluster const &a, Cluster const &b) {
+		return a.key > b.key;
+	});
+
+	std::vector< uint32_t > result;
+	result.reserve(triangle_count * 3);
+	for (auto const &cluster : sorted) {
+		result.insert(result.end(), indices + 3 * cluster.begin, indices + 3 * cluster.end);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, std::vector< uint32_t > *order_) {
+	assert(order_);
+	auto &order = *order_;
+	order.clear();
+	order.reserve(vertex_count);
+
+	std::vector< uint32_t > remap(vertex_count, -1U);
+	for (uint32_t i = 0; i < index_count; ++i) {
+		uint32_t &to = remap[indices[i]];
+		if (to == -1U) {
+			to = order.size();
+			order.emplace_back(indices[i]);
+		}
+		indices[i] = to;
+	}
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		if (remap[v] == -1U) order.emplace_back(v);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+//"MeshOptimizer" reorders indexed triangle lists (three indices per triangle) for the GPU:
+// optimize_vertex_cache() orders triangles for post-transform cache hits (Tipsify: Sander, Nehab & Barczak,
+//  "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007);
+// optimize_overdraw() then splits that order into clusters and sorts the clusters so that ones facing
+//  out from the mesh's center draw first (so early-Z rejects more of what's behind them), trading a
+//  little cache efficiency (bounded by 'threshold');
+// optimize_vertex_fetch() finally renumbers vertices in order of first use, so fetches walk memory forward.
+//
+//analyze_vertex_cache() measures a FIFO cache of 'cache_size' entries:
+// ACMR = vertices transformed per triangle (0.5 is ideal for large grids, 3 is no reuse at all);
+// ATVR = vertices transformed per distinct vertex (1 is ideal).
+
+struct VertexCacheStats {
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+VertexCacheStats analyze_vertex_cache(uint32_t const *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = 16);
+
+//reorder triangles in place; if 'clusters' is given, it gets the first triangle of each run that started
+// from a cold cache (these are the places optimize_overdraw() may cut without losing cache hits):
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = 16, std::vector< uint32_t > *clusters = nullptr);
+
+//reorder (cache-ordered) triangles in place; 'positions' has vertex_count entries:
+// note: 'threshold' is the allowed increase in ACMR (1.05 allows 5% more cache misses).
+void optimize_overdraw(uint32_t *indices, uint32_t index_count, glm::vec3 const *positions, uint32_t vertex_count,
+	std::vector< uint32_t > const &clusters, uint32_t cache_size = 16, float threshold = 1.05f);
+
+//renumber vertices in order of first use (updating 'indices' in place);
+// 'order' gets the old index of each new vertex (vertices that are never used go last, in their old order):
+void optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, std::vector< uint32_t > *order);
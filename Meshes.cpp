@@ -1,127 +1,992 @@
 #include "Meshes.hpp"
-#include "read_chunk.hpp"
+#include "MeshOptimizer.hpp"
+#include "MappedBlob.hpp"
+#include "BlobWriter.hpp"
+#include "ThreadPool.hpp"
+#include "Checksum.hpp"
 
 #include <glm/glm.hpp>
 
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
 
-void Meshes::load(std::string const &filename, Attributes const &attributes) {
-	std::ifstream file(filename, std::ios::binary);
+#if defined(__SSE2__) || defined(_M_X64)
+#define MESHES_SSE 1
+#include <emmintrin.h>
+#endif
 
-	GLuint vao = 0;
-	GLuint total = 0;
-	{ //read + upload data chunk:
-		struct v3n3u2 {
-			glm::vec3 v;
-			glm::vec3 n;
-			glm::vec2 uvcoord;
-		};
-		static_assert(sizeof(v3n3u2) == 32, "v3n3u2 is packed");
-		std::vector< v3n3u2 > data;
-		read_chunk(file, "v3n3", &data);
-
-		//upload data:
-		GLuint buffer = 0;
-		glGenBuffers(1, &buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(v3n3u2) * data.size(), &data[0], GL_STATIC_DRAW);
-
-		total = data.size(); //store total for later checks on index
-
-		//store binding:
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-		if (attributes.Position != -1U) {
-			glVertexAttribPointer(attributes.Position, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3u2), (GLbyte *)0);
-			glEnableVertexAttribArray(attributes.Position);
-		} else {
-			std::cerr << "WARNING: loading v3n3u2 data from '" << filename << "', but not using the Position attribute." << std::endl;
+//IEEE half float conversion (round to nearest even):
+static uint16_t float_to_half(float f) {
+	uint32_t x;
+	std::memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t mantissa = x & 0x7fffff;
+	if (((x >> 23) & 0xff) == 0xff) return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0)); //inf / nan
+	int32_t exponent = int32_t((x >> 23) & 0xff) - 127 + 15;
+	if (exponent >= 31) return uint16_t(sign | 0x7c00); //too large: inf
+	if (exponent <= 0) { //subnormal (or zero)
+		if (exponent < -10) return uint16_t(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = uint32_t(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t middle = 1u << (shift - 1);
+		if (rest > middle || (rest == middle && (half & 1))) ++half;
+		return uint16_t(sign | half);
+	}
+	uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half; //(a carry into the exponent is still correct)
+	return uint16_t(sign | half);
+}
+
+static float half_to_float(uint16_t h) {
+	uint32_t sign = uint32_t(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	if (exponent == 0) {
+		float value = std::ldexp(float(mantissa), -24);
+		return sign ? -value : value;
+	}
+	uint32_t x = sign | (exponent == 31 ? 0x7f800000 : (exponent + 112) << 23) | (mantissa << 13);
+	float f;
+	std::memcpy(&f, &x, 4);
+	return f;
+}
+
+//snorm16 <-> float (with the GL 4.2+ mapping, which older drivers are within a rounding step of):
+static int16_t to_snorm16(float v) {
+	return int16_t(std::lround(std::min(1.0f, std::max(-1.0f, v)) * 32767.0f));
+}
+static float from_snorm16(int16_t v) {
+	return std::max(-1.0f, v / 32767.0f);
+}
+
+Meshes::PackedVertex Meshes::pack(Vertex const &vertex, Box const &box) {
+	PackedVertex ret;
+	for (uint32_t i = 0; i < 3; ++i) {
+		float t = (box.size[i] > 0.0f ? (vertex.Position[i] - box.min[i]) / box.size[i] : 0.0f);
+		ret.Position[i] = uint16_t(std::lround(std::min(1.0f, std::max(0.0f, t)) * 65535.0f));
+	}
+	ret.Position[3] = 0;
+
+	//octahedral normal: project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half out over the corners:
+	glm::vec3 n = vertex.Normal;
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 oct = (l1 > 0.0f ? glm::vec2(n.x, n.y) / l1 : glm::vec2(0.0f));
+	if (l1 > 0.0f && n.z < 0.0f) {
+		oct = glm::vec2(
+			(1.0f - std::abs(oct.y)) * (oct.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::abs(oct.x)) * (oct.y >= 0.0f ? 1.0f : -1.0f)
+		);
+	}
+	ret.Normal[0] = to_snorm16(oct.x);
+	ret.Normal[1] = to_snorm16(oct.y);
+
+	ret.UVCoord[0] = float_to_half(vertex.UVCoord.x);
+	ret.UVCoord[1] = float_to_half(vertex.UVCoord.y);
+	return ret;
+}
+
+Meshes::Vertex Meshes::unpack(PackedVertex const &vertex, Box const &box) {
+	Vertex ret;
+	for (uint32_t i = 0; i < 3; ++i) {
+		ret.Position[i] = box.min[i] + (vertex.Position[i] / 65535.0f) * box.size[i];
+	}
+
+	//(same as the decode in the vertex shader:)
+	glm::vec2 oct(from_snorm16(vertex.Normal[0]), from_snorm16(vertex.Normal[1]));
+	glm::vec3 n(oct.x, oct.y, 1.0f - std::abs(oct.x) - std::abs(oct.y));
+	if (n.z < 0.0f) {
+		n.x = (1.0f - std::abs(oct.y)) * (oct.x >= 0.0f ? 1.0f : -1.0f);
+		n.y = (1.0f - std::abs(oct.x)) * (oct.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	ret.Normal = glm::normalize(n);
+
+	ret.UVCoord = glm::vec2(half_to_float(vertex.UVCoord[0]), half_to_float(vertex.UVCoord[1]));
+	return ret;
+}
+
+//min/max over float positions:
+static void reduce_bounds(Meshes::Vertex const *vertices, uint32_t count, Mesh const &, glm::vec3 *min_, glm::vec3 *max_) {
+	glm::vec3 &min = *min_;
+	glm::vec3 &max = *max_;
+	min = max = vertices[0].Position;
+	uint32_t i = 0;
+#ifdef MESHES_SSE
+	//(loads Position plus Normal.x, which stays in the unused fourth lane)
+	__m128 min4 = _mm_loadu_ps(&vertices[0].Position.x);
+	__m128 max4 = min4;
+	for (; i < count; ++i) {
+		__m128 p = _mm_loadu_ps(&vertices[i].Position.x);
+		min4 = _mm_min_ps(min4, p);
+		max4 = _mm_max_ps(max4, p);
+	}
+	float out[4];
+	_mm_storeu_ps(out, min4);
+	min = glm::vec3(out[0], out[1], out[2]);
+	_mm_storeu_ps(out, max4);
+	max = glm::vec3(out[0], out[1], out[2]);
+#endif
+	for (; i < count; ++i) {
+		min = glm::min(min, vertices[i].Position);
+		max = glm::max(max, vertices[i].Position);
+	}
+}
+
+//min/max over quantized positions (decoded through the mesh's box):
+static void reduce_bounds(Meshes::PackedVertex const *vertices, uint32_t count, Mesh const &mesh, glm::vec3 *min_, glm::vec3 *max_) {
+	uint16_t min[3] = {vertices[0].Position[0], vertices[0].Position[1], vertices[0].Position[2]};
+	uint16_t max[3] = {min[0], min[1], min[2]};
+	uint32_t i = 0;
+#ifdef MESHES_SSE
+	//SSE2 only has signed 16-bit min/max, so flip the sign bits to compare unsigned values:
+	__m128i bias = _mm_set1_epi16(-0x8000);
+	__m128i min8 = _mm_xor_si128(_mm_loadl_epi64(reinterpret_cast< __m128i const * >(vertices[0].Position)), bias);
+	__m128i max8 = min8;
+	for (; i < count; ++i) {
+		__m128i p = _mm_xor_si128(_mm_loadl_epi64(reinterpret_cast< __m128i const * >(vertices[i].Position)), bias);
+		min8 = _mm_min_epi16(min8, p);
+		max8 = _mm_max_epi16(max8, p);
+	}
+	uint16_t out[8];
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out), _mm_xor_si128(min8, bias));
+	std::copy(out, out + 3, min);
+	_mm_storeu_si128(reinterpret_cast< __m128i * >(out), _mm_xor_si128(max8, bias));
+	std::copy(out, out + 3, max);
+#endif
+	for (; i < count; ++i) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			min[c] = std::min(min[c], vertices[i].Position[c]);
+			max[c] = std::max(max[c], vertices[i].Position[c]);
 		}
-		if (attributes.Normal != -1U) {
-			glVertexAttribPointer(attributes.Normal, 3, GL_FLOAT, GL_FALSE, sizeof(v3n3u2), (GLbyte *)0 + sizeof(glm::vec3));
-			glEnableVertexAttribArray(attributes.Normal);
-		} else {
-			std::cerr << "WARNING: loading v3n3u2 data from '" << filename << "', but not using the Normal attribute." << std::endl;
+	}
+	*min_ = mesh.box_min + glm::vec3(min[0], min[1], min[2]) / 65535.0f * mesh.box_size;
+	*max_ = mesh.box_min + glm::vec3(max[0], max[1], max[2]) / 65535.0f * mesh.box_size;
+}
+
+//bounding box of some float vertices:
+static Meshes::Box compute_box(Meshes::Vertex const *vertices, uint32_t count) {
+	Meshes::Box box;
+	box.min = box.size = glm::vec3(0.0f);
+	if (count == 0) return box;
+	glm::vec3 max;
+	reduce_bounds(vertices, count, Mesh(), &box.min, &max);
+	box.size = max - box.min;
+	return box;
+}
+
+//append the distinct vertices of vertices[0, count) to 'unique' and one index per input vertex
+// (relative to the first appended vertex) to 'indices'. Vertices are merged only if bitwise identical:
+template< typename V >
+static void weld(V const *vertices, uint32_t count, std::vector< V > *unique_, std::vector< uint32_t > *indices_) {
+	assert(unique_);
+	assert(indices_);
+	auto &unique = *unique_;
+	auto &indices = *indices_;
+	static_assert(sizeof(V) % 4 == 0, "vertices hash as 32-bit words");
+
+	uint32_t base = unique.size();
+	//open-addressed table of (index into unique - base), at most half full:
+	uint32_t table_size = 16;
+	while (table_size < 2 * count) table_size *= 2;
+	std::vector< uint32_t > table(table_size, -1U);
+
+	for (uint32_t i = 0; i < count; ++i) {
+		V const &vertex = vertices[i];
+		uint32_t words[sizeof(V) / 4];
+		std::memcpy(words, &vertex, sizeof(V));
+		uint32_t hash = 2166136261u;
+		for (uint32_t w : words) {
+			hash = (hash ^ w) * 16777619u;
 		}
-		if (attributes.UVCoord != -1U) {
-			glVertexAttribPointer(attributes.UVCoord, 2, GL_FLOAT, GL_FALSE, sizeof(v3n3u2), (GLbyte *)0 + sizeof(glm::vec3) * 2);
-			glEnableVertexAttribArray(attributes.UVCoord);
-		} else {
-			std::cerr << "WARNING: loading v3n3u2 data from '" << filename << "', but not using the UVCoord attribute." << std::endl;
+		hash ^= hash >> 15; //(FNV on words mixes the high bits poorly)
+
+		uint32_t slot = hash & (table_size - 1);
+		while (table[slot] != -1U && std::memcmp(&unique[base + table[slot]], &vertex, sizeof(V)) != 0) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] == -1U) {
+			table[slot] = unique.size() - base;
+			unique.emplace_back(vertex);
 		}
+		indices.emplace_back(table[slot]);
 	}
+}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+void Meshes::File::read(std::string const &filename_) {
+	read(std::make_shared< MappedBlob >(filename_));
+}
+
+void Meshes::File::read(std::shared_ptr< MappedBlob > const &blob_) {
+	*this = File();
+	filename = blob_->filename;
+
+	blob = blob_;
+	blob->verify_pool = &ThreadPool::shared();
+	MappedBlob &file = *blob;
+
+	//chunks are looked up by name, so they may be in any order (other chunks are ignored):
+	//vertex data is floats ('v3n3') or quantized ('qv16'):
+	bool quantized = file.has_chunk("qv16");
+	if (quantized) {
+		packed = file.find_chunk< PackedVertex >("qv16");
+	} else {
+		floats = file.find_chunk< Vertex >("v3n3");
+	}
+	size_t vertex_count = floats.size + packed.size;
+
+	//cooked files are already indexed:
+	if (file.has_chunk("ix32")) {
+		indices = file.find_chunk< uint32_t >("ix32");
+	}
+
+	BlobSpan< char > strings = file.find_chunk< char >("str0");
 
 	{ //read index chunk, add to meshes:
+		//'idx1' entries (cooked files) also carry an index range:
 		struct IndexEntry {
 			uint32_t name_begin, name_end;
 			uint32_t vertex_start, vertex_count;
+			uint32_t index_start = 0, index_count = 0;
 		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
-
 		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		if (!indices.empty()) {
+			BlobSpan< IndexEntry > index1 = file.find_chunk< IndexEntry >("idx1");
+			index.assign(index1.begin(), index1.end());
+		} else {
+			struct IndexEntry0 {
+				uint32_t name_begin, name_end;
+				uint32_t vertex_start, vertex_count;
+			};
+			static_assert(sizeof(IndexEntry0) == 16, "Index entry should be packed");
+			BlobSpan< IndexEntry0 > index0 = file.find_chunk< IndexEntry0 >("idx0");
+			index.resize(index0.size);
+			for (uint32_t i = 0; i < index0.size; ++i) {
+				index[i].name_begin = index0[i].name_begin;
+				index[i].name_end = index0[i].name_end;
+				index[i].vertex_start = index0[i].vertex_start;
+				index[i].vertex_count = index0[i].vertex_count;
+			}
+		}
+		static_assert(sizeof(IndexEntry) == 24, "Index entry should be packed");
 
 		for (auto const &entry : index) {
-			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size)) {
 				throw std::runtime_error("index entry has out-of-range name begin/end");
 			}
-			if (!(entry.vertex_start < entry.vertex_start + entry.vertex_count && entry.vertex_start + entry.vertex_count <= total)) {
+			if (!(entry.vertex_start < entry.vertex_start + entry.vertex_count && entry.vertex_start + entry.vertex_count <= vertex_count)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+			std::string name(strings.data + entry.name_begin, strings.data + entry.name_end);
 			Mesh mesh;
-			mesh.vao = vao;
 			mesh.start = entry.vertex_start;
 			mesh.count = entry.vertex_count;
-/*
-			mesh.max = data[mesh.start].v;
-			mesh.min = data[mesh.start].v;
-
-			for (auto i = mesh.start; i < mesh.start + mesh.count; i++) {
-				if (mesh.max.x > data[i].v.x) {
-					mesh.max.x = data[i].v.x;
-				}
-				if (mesh.max.y > data[i].v.y) {
-					mesh.max.y = data[i].v.y;
+			if (!indices.empty()) {
+				if (!(entry.index_start <= entry.index_start + entry.index_count && entry.index_start + entry.index_count <= indices.size && entry.index_count % 3 == 0)) {
+					throw std::runtime_error("index entry has out-of-range index start/count");
 				}
-				if (mesh.max.z > data[i].v.z) {
-					mesh.max.z = data[i].v.z;
+				for (uint32_t i = entry.index_start; i < entry.index_start + entry.index_count; ++i) {
+					if (indices[i] >= entry.vertex_count) {
+						throw std::runtime_error("mesh '" + name + "' has an out-of-range index");
+					}
 				}
+				mesh.index_start = entry.index_start;
+				mesh.index_count = entry.index_count;
+			}
+			entries.emplace_back(name, mesh);
+		}
+	}
 
-				if (mesh.max.x > data[i].v.x) {
-					mesh.max.x = data[i].v.x;
-				}
-				if (mesh.max.y > data[i].v.y) {
-					mesh.max.y = data[i].v.y;
-				}
-				if (mesh.max.z > data[i].v.z) {
-					mesh.max.z = data[i].v.z;
+	if (quantized) { //read bounds chunk, one box per index entry:
+		BlobSpan< Box > boxes = file.find_chunk< Box >("box0");
+		if (boxes.size != entries.size()) {
+			throw std::runtime_error("mesh file has " + std::to_string(boxes.size) + " boxes for " + std::to_string(entries.size()) + " meshes");
+		}
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			entries[i].second.box_min = boxes[i].min;
+			entries[i].second.box_size = boxes[i].size;
+		}
+	}
+
+	if (file.has_chunk("bnd0")) { //precomputed bounds, one per index entry:
+		BlobSpan< Bounds > bounds = file.find_chunk< Bounds >("bnd0");
+		if (bounds.size != entries.size()) {
+			throw std::runtime_error("mesh file has " + std::to_string(bounds.size) + " bounds for " + std::to_string(entries.size()) + " meshes");
+		}
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			Mesh &mesh = entries[i].second;
+			mesh.bounds_min = bounds[i].min;
+			mesh.bounds_max = bounds[i].max;
+			mesh.sphere_center = bounds[i].sphere_center;
+			mesh.sphere_radius = bounds[i].sphere_radius;
+		}
+		has_bounds = true;
+	}
+
+	if (file.trailing_bytes) {
+		std::cerr << "WARNING: trailing data in mesh file '" + filename + "'" << std::endl;
+	}
+}
+
+void Meshes::File::write(std::string const &filename, bool compress) const {
+	BlobWriter writer;
+	add_chunks(&writer, compress);
+	writer.write(filename);
+}
+
+void Meshes::File::add_chunks(BlobWriter *writer_, bool compress) const {
+	BlobWriter &writer = *writer_;
+	if (!floats.empty() || indices.empty()) {
+		throw std::runtime_error("Only quantized, indexed meshes can be written (quantize() and weld() first).");
+	}
+
+	std::vector< char > strings;
+	std::vector< uint32_t > index; //(idx1 entries, six words each)
+	std::vector< Box > boxes;
+	std::vector< Bounds > bounds;
+	for (auto const &entry : entries) {
+		Mesh const &mesh = entry.second;
+		index.emplace_back(strings.size());
+		strings.insert(strings.end(), entry.first.begin(), entry.first.end());
+		index.emplace_back(strings.size());
+		index.emplace_back(mesh.start);
+		index.emplace_back(mesh.count);
+		index.emplace_back(mesh.index_start);
+		index.emplace_back(mesh.index_count);
+		Box box;
+		box.min = mesh.box_min;
+		box.size = mesh.box_size;
+		boxes.emplace_back(box);
+		Bounds b;
+		b.min = mesh.bounds_min;
+		b.max = mesh.bounds_max;
+		b.sphere_center = mesh.sphere_center;
+		b.sphere_radius = mesh.sphere_radius;
+		bounds.emplace_back(b);
+	}
+
+	//small chunks first, so reading the directory of meshes touches as few pages as possible:
+	writer.add_chunk_copy("str0", strings);
+	writer.add_chunk_copy("idx1", index);
+	writer.add_chunk_copy("box0", boxes);
+	if (has_bounds) writer.add_chunk_copy("bnd0", bounds);
+	if (compress) {
+		writer.add_compressed_chunk("qv16", packed.data, packed.size, FilterAuto);
+		writer.add_compressed_chunk("ix32", indices.data, indices.size, FilterAuto);
+	} else {
+		writer.add_chunk("qv16", packed.data, packed.size, 4096);
+		writer.add_chunk("ix32", indices.data, indices.size, 4096);
+	}
+}
+
+//make sure 'span' points at 'storage' (copying it out of the mapped file if needed), so it can be modified:
+template< typename T >
+static T *own(BlobSpan< T > *span, std::vector< T > *storage) {
+	if (span->data != storage->data() || span->size != storage->size()) {
+		storage->assign(span->begin(), span->end());
+		*span = BlobSpan< T >(*storage);
+	}
+	return storage->data();
+}
+
+//keep just the meshes in 'entries' named in 'names', with their data packed together:
+template< typename V >
+static void select_meshes(std::string const &filename, std::vector< std::string > const &names, BlobSpan< V > *vertices, std::vector< V > *storage,
+	BlobSpan< uint32_t > *indices, std::vector< uint32_t > *index_storage, std::vector< std::pair< std::string, Mesh > > *entries) {
+	std::vector< std::pair< std::string, Mesh > > selected;
+	std::vector< V > selected_vertices;
+	std::vector< uint32_t > selected_indices;
+	for (auto const &name : names) {
+		auto f = std::find_if(entries->begin(), entries->end(), [&name](std::pair< std::string, Mesh > const &entry) {
+			return entry.first == name;
+		});
+		if (f == entries->end()) {
+			std::cerr << "WARNING: mesh '" << name << "' isn't in '" << filename << "'." << std::endl;
+			continue;
+		}
+		Mesh mesh = f->second;
+		uint32_t start = selected_vertices.size();
+		selected_vertices.insert(selected_vertices.end(), vertices->begin() + mesh.start, vertices->begin() + mesh.start + mesh.count);
+		mesh.start = start;
+		if (mesh.index_count) {
+			uint32_t index_start = selected_indices.size();
+			selected_indices.insert(selected_indices.end(), indices->begin() + mesh.index_start, indices->begin() + mesh.index_start + mesh.index_count);
+			mesh.index_start = index_start;
+		}
+		selected.emplace_back(name, mesh);
+	}
+	*entries = std::move(selected);
+	*storage = std::move(selected_vertices);
+	*vertices = BlobSpan< V >(*storage);
+	if (!indices->empty()) {
+		*index_storage = std::move(selected_indices);
+		*indices = BlobSpan< uint32_t >(*index_storage);
+	}
+}
+
+void Meshes::File::select(std::vector< std::string > const &names) {
+	only = names;
+	if (!packed.empty()) select_meshes(filename, names, &packed, &packed_storage, &indices, &index_storage, &entries);
+	else select_meshes(filename, names, &floats, &float_storage, &indices, &index_storage, &entries);
+}
+
+void Meshes::File::quantize() {
+	if (floats.empty()) return;
+	//each mesh relative to its own bounds:
+	packed_storage.clear();
+	packed_storage.reserve(floats.size);
+	for (auto &entry : entries) {
+		Mesh &mesh = entry.second;
+		Box box = compute_box(&floats[mesh.start], mesh.count);
+		uint32_t start = packed_storage.size();
+		for (uint32_t i = 0; i < mesh.count; ++i) {
+			packed_storage.emplace_back(pack(floats[mesh.start + i], box));
+		}
+		mesh.start = start;
+		mesh.box_min = box.min;
+		mesh.box_size = box.size;
+	}
+	packed = BlobSpan< PackedVertex >(packed_storage);
+	floats = BlobSpan< Vertex >();
+	float_storage.clear();
+}
+
+void Meshes::File::dequantize() {
+	if (packed.empty()) return;
+	float_storage.clear();
+	float_storage.reserve(packed.size);
+	for (auto &entry : entries) {
+		Mesh &mesh = entry.second;
+		Box box;
+		box.min = mesh.box_min;
+		box.size = mesh.box_size;
+		uint32_t start = float_storage.size();
+		for (uint32_t i = 0; i < mesh.count; ++i) {
+			float_storage.emplace_back(unpack(packed[mesh.start + i], box));
+		}
+		mesh.start = start;
+		mesh.box_min = glm::vec3(0.0f);
+		mesh.box_size = glm::vec3(1.0f);
+	}
+	floats = BlobSpan< Vertex >(float_storage);
+	packed = BlobSpan< PackedVertex >();
+	packed_storage.clear();
+}
+
+//weld every mesh in 'entries' from 'vertices', updating the entries' ranges, and print how much was saved:
+template< typename V >
+static void weld_meshes(std::string const &filename, BlobSpan< V > *vertices, std::vector< V > *storage, std::vector< std::pair< std::string, Mesh > > *entries, std::vector< uint32_t > *indices) {
+	std::vector< V > unique;
+	uint64_t total_before = 0, total_after = 0;
+	for (auto &entry : *entries) {
+		Mesh &mesh = entry.second;
+		uint32_t base = unique.size();
+		uint32_t first = indices->size();
+		weld(&(*vertices)[mesh.start], mesh.count, &unique, indices);
+		uint32_t welded = unique.size() - base;
+
+		uint64_t index_size = (welded <= 0x10000 ? 2 : 4);
+		uint64_t before = uint64_t(mesh.count) * sizeof(V);
+		uint64_t after = uint64_t(welded) * sizeof(V) + uint64_t(mesh.count) * index_size;
+		std::cout << "  " << entry.first << ": " << mesh.count << " -> " << welded << " vertices, "
+			<< before << " -> " << after << " bytes; saves up to " << (mesh.count - welded) << " of " << mesh.count << " vertex shader runs per draw." << std::endl;
+		total_before += before;
+		total_after += after;
+
+		mesh.index_start = first;
+		mesh.index_count = mesh.count;
+		mesh.start = base;
+		mesh.count = welded;
+	}
+	std::cout << "Welded '" << filename << "': " << total_before << " -> " << total_after << " bytes of vertex + index data." << std::endl;
+	*storage = std::move(unique);
+	*vertices = BlobSpan< V >(*storage);
+}
+
+void Meshes::File::weld() {
+	if (!indices.empty()) return;
+	index_storage.clear();
+	if (!packed.empty()) weld_meshes(filename, &packed, &packed_storage, &entries, &index_storage);
+	else weld_meshes(filename, &floats, &float_storage, &entries, &index_storage);
+	indices = BlobSpan< uint32_t >(index_storage);
+}
+
+//object-space position of a vertex:
+static glm::vec3 position_of(Meshes::Vertex const &vertex, Mesh const &) {
+	return vertex.Position;
+}
+static glm::vec3 position_of(Meshes::PackedVertex const &vertex, Mesh const &mesh) {
+	return mesh.box_min + glm::vec3(vertex.Position[0], vertex.Position[1], vertex.Position[2]) / 65535.0f * mesh.box_size;
+}
+
+//run MeshOptimizer on each mesh's indices, then put its vertices in the order it asks for:
+template< typename V >
+static void optimize_meshes(std::string const &filename, V *vertices, std::vector< std::pair< std::string, Mesh > > *entries, uint32_t *indices) {
+	double misses_before = 0.0, misses_after = 0.0;
+	uint32_t triangles = 0;
+	std::vector< uint32_t > clusters;
+	std::vector< glm::vec3 > positions;
+	std::vector< uint32_t > order;
+	std::vector< V > reordered;
+	for (auto &entry : *entries) {
+		Mesh const &mesh = entry.second;
+		if (mesh.index_count == 0) continue;
+		uint32_t *mesh_indices = indices + mesh.index_start;
+		V *mesh_vertices = vertices + mesh.start;
+
+		VertexCacheStats before = analyze_vertex_cache(mesh_indices, mesh.index_count, mesh.count);
+
+		optimize_vertex_cache(mesh_indices, mesh.index_count, mesh.count, 16, &clusters);
+
+		positions.resize(mesh.count);
+		for (uint32_t i = 0; i < mesh.count; ++i) {
+			positions[i] = position_of(mesh_vertices[i], mesh);
+		}
+		optimize_overdraw(mesh_indices, mesh.index_count, positions.data(), mesh.count, clusters);
+
+		optimize_vertex_fetch(mesh_indices, mesh.index_count, mesh.count, &order);
+		reordered.resize(mesh.count);
+		for (uint32_t i = 0; i < mesh.count; ++i) {
+			reordered[i] = mesh_vertices[order[i]];
+		}
+		std::copy(reordered.begin(), reordered.end(), mesh_vertices);
+
+		VertexCacheStats after = analyze_vertex_cache(mesh_indices, mesh.index_count, mesh.count);
+		std::cout << "  " << entry.first << ": ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << "." << std::endl;
+
+		misses_before += before.acmr * (mesh.index_count / 3);
+		misses_after += after.acmr * (mesh.index_count / 3);
+		triangles += mesh.index_count / 3;
+	}
+	if (triangles) {
+		std::cout << "Optimized '" << filename << "': ACMR " << misses_before / triangles << " -> " << misses_after / triangles << " over " << triangles << " triangles." << std::endl;
+	}
+}
+
+void Meshes::File::optimize() {
+	uint32_t *index_data = own(&indices, &index_storage);
+	if (!packed.empty()) optimize_meshes(filename, own(&packed, &packed_storage), &entries, index_data);
+	else optimize_meshes(filename, own(&floats, &float_storage), &entries, index_data);
+}
+
+//bounds of every mesh in 'entries' from 'vertices':
+template< typename V >
+static void compute_mesh_bounds(BlobSpan< V > const &vertices, std::vector< std::pair< std::string, Mesh > > *entries) {
+	for (auto &entry : *entries) {
+		Mesh &mesh = entry.second;
+		if (mesh.count == 0) continue;
+		V const *mesh_vertices = &vertices[mesh.start];
+		reduce_bounds(mesh_vertices, mesh.count, mesh, &mesh.bounds_min, &mesh.bounds_max);
+
+		//the tighter of two spheres: one around the box center (never larger than the box's circumsphere),
+		// and Ritter's (around the two points farthest apart along a rough diameter, grown to take in any
+		// vertex left outside), each with the exact radius for its center:
+		auto radius_around = [&](glm::vec3 const &center) {
+			float radius2 = 0.0f;
+			for (uint32_t i = 0; i < mesh.count; ++i) {
+				glm::vec3 d = position_of(mesh_vertices[i], mesh) - center;
+				radius2 = std::max(radius2, glm::dot(d, d));
+			}
+			return std::sqrt(radius2);
+		};
+		auto farthest_from = [&](glm::vec3 const &from) {
+			glm::vec3 best = from;
+			float best2 = -1.0f;
+			for (uint32_t i = 0; i < mesh.count; ++i) {
+				glm::vec3 p = position_of(mesh_vertices[i], mesh);
+				float d2 = glm::dot(p - from, p - from);
+				if (d2 > best2) {
+					best2 = d2;
+					best = p;
 				}
 			}
-*/
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			return best;
+		};
+		glm::vec3 a = farthest_from(position_of(mesh_vertices[0], mesh));
+		glm::vec3 b = farthest_from(a);
+		glm::vec3 ritter_center = 0.5f * (a + b);
+		float ritter_radius = 0.5f * glm::length(b - a);
+		for (uint32_t i = 0; i < mesh.count; ++i) {
+			glm::vec3 p = position_of(mesh_vertices[i], mesh);
+			float d = glm::length(p - ritter_center);
+			if (d > ritter_radius) { //(move the center toward p just enough to reach it)
+				float grown = 0.5f * (ritter_radius + d);
+				ritter_center += ((d - grown) / d) * (p - ritter_center);
+				ritter_radius = grown;
 			}
 		}
+
+		glm::vec3 box_center = 0.5f * (mesh.bounds_min + mesh.bounds_max);
+		float box_radius = radius_around(box_center);
+		ritter_radius = radius_around(ritter_center); //(exact, rather than as grown in floating point)
+		mesh.sphere_center = (ritter_radius < box_radius ? ritter_center : box_center);
+		mesh.sphere_radius = std::min(ritter_radius, box_radius);
 	}
+}
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in mesh file '" + filename + "'" << std::endl;
+void Meshes::File::compute_bounds() {
+	if (!packed.empty()) compute_mesh_bounds(packed, &entries);
+	else compute_mesh_bounds(floats, &entries);
+	has_bounds = true;
+}
+
+MeshHandle Meshes::handle(std::string const &name) {
+	MeshHandle handle;
+	handle.index = names.intern(name);
+	return handle;
+}
+
+//hash of each mesh's data (before its entry is offset to where the data lands):
+template< typename V >
+static std::vector< uint32_t > hash_meshes(BlobSpan< V > const &vertices, BlobSpan< uint32_t > const &indices, std::vector< std::pair< std::string, Mesh > > const &entries) {
+	std::vector< uint32_t > hashes;
+	hashes.reserve(entries.size());
+	for (auto const &entry : entries) {
+		Mesh const &mesh = entry.second;
+		uint32_t hash = crc32c(vertices.data + mesh.start, mesh.count * sizeof(V));
+		hash = crc32c(indices.data + mesh.index_start, mesh.index_count * sizeof(uint32_t), hash);
+		hash = crc32c(&mesh.box_min, sizeof(mesh.box_min), hash);
+		hash = crc32c(&mesh.box_size, sizeof(mesh.box_size), hash);
+		hashes.emplace_back(hash);
 	}
+	return hashes;
+}
+
+static std::vector< uint32_t > hash_meshes(Meshes::File const &file) {
+	if (!file.packed.empty()) return hash_meshes(file.packed, file.indices, file.entries);
+	else return hash_meshes(file.floats, file.indices, file.entries);
+}
+
+void Meshes::add_meshes(File const &from, std::vector< uint32_t > const &hashes, Placement const &placement) {
+	std::string const &filename = from.filename;
+	loaded_files.emplace_back();
+	LoadedFile &file = loaded_files.back();
+	file.filename = filename;
+	file.only = from.only;
+	file.placement = placement;
+	for (uint32_t e = 0; e < from.entries.size(); ++e) {
+		auto const &entry = from.entries[e];
+		uint32_t index = names.intern(entry.first);
+		if (index >= meshes.size()) {
+			meshes.resize(names.size());
+			loaded.resize(names.size(), false);
+		}
+		if (loaded[index]) {
+			std::cerr << "WARNING: mesh name '" + entry.first + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			continue;
+		}
+		meshes[index] = entry.second;
+		loaded[index] = true;
+		MeshHandle handle;
+		handle.index = index;
+		file.handles.emplace_back(handle);
+		file.hashes.emplace_back(hashes[e]);
+	}
+}
+
+void Meshes::unload(std::string const &filename) {
+	bool found = false;
+	for (auto f = loaded_files.begin(); f != loaded_files.end(); ) {
+		if (f->filename != filename) {
+			++f;
+			continue;
+		}
+		found = true;
+		for (auto const &handle : f->handles) {
+			loaded[handle.index] = false;
+		}
+		if (f->placement.arena) {
+			f->placement.arena->free_vertices(f->placement.vertices);
+			f->placement.arena->free_indices(f->placement.indices);
+		}
+		for (auto const &moved : f->moved) {
+			moved.arena->free_vertices(moved.vertices);
+			moved.arena->free_indices(moved.indices);
+		}
+		f = loaded_files.erase(f);
+	}
+	if (!found) {
+		std::cerr << "WARNING: unloading '" << filename << "', which isn't loaded." << std::endl;
+	}
+}
+
+Meshes::File Meshes::prepare_load(std::string const &filename, std::vector< std::string > const &only) const {
+	File file;
+	file.read(filename);
+	if (!only.empty()) file.select(only);
+	file.quantize();
+	if (file.indices.empty()) { //(cooked files are already welded and optimized)
+		file.weld();
+		if (optimize_on_load) file.optimize();
+	}
+	if (!file.has_bounds) file.compute_bounds();
+
+	//16-bit indices if every mesh fits:
+	bool short_indices = true;
+	for (auto const &entry : file.entries) {
+		if (entry.second.count > 0x10000) short_indices = false;
+	}
+	for (auto &entry : file.entries) {
+		entry.second.index_type = (short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+	}
+	if (short_indices) {
+		file.short_indices.assign(file.indices.begin(), file.indices.end());
+	}
+	file.blob->wait_verified();
+	return file;
+}
+
+void const *Meshes::File::index_data() const {
+	if (!short_indices.empty()) return short_indices.data();
+	return indices.data;
+}
+
+size_t Meshes::File::index_bytes() const {
+	if (!short_indices.empty()) return short_indices.size() * sizeof(uint16_t);
+	return indices.size * sizeof(uint32_t);
+}
+
+Meshes::Placement Meshes::place(File const &file, Attributes const &attributes) {
+	if (attributes.Position == -1U) {
+		std::cerr << "WARNING: loading mesh data from '" << file.filename << "', but not using the Position attribute." << std::endl;
+	}
+	if (attributes.Normal == -1U) {
+		std::cerr << "WARNING: loading mesh data from '" << file.filename << "', but not using the Normal attribute." << std::endl;
+	}
+	if (attributes.UVCoord == -1U) {
+		std::cerr << "WARNING: loading mesh data from '" << file.filename << "', but not using the UVCoord attribute." << std::endl;
+	}
+
+	//find (or make) the arena for these attribute bindings:
+	Arena *arena = nullptr;
+	for (auto &a : arenas) {
+		if (a.attributes.Position == attributes.Position && a.attributes.Normal == attributes.Normal && a.attributes.UVCoord == attributes.UVCoord) {
+			arena = &a;
+		}
+	}
+	if (!arena) {
+		arenas.emplace_back();
+		arena = &arenas.back();
+		arena->attributes = attributes;
+		arena->arena.reset(new GeometryArena(sizeof(PackedVertex), [attributes](){
+			if (attributes.Position != -1U) {
+				glVertexAttribPointer(attributes.Position, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (GLbyte *)0);
+				glEnableVertexAttribArray(attributes.Position);
+			}
+			if (attributes.Normal != -1U) {
+				glVertexAttribPointer(attributes.Normal, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (GLbyte *)0 + offsetof(PackedVertex, Normal));
+				glEnableVertexAttribArray(attributes.Normal);
+			}
+			if (attributes.UVCoord != -1U) {
+				glVertexAttribPointer(attributes.UVCoord, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (GLbyte *)0 + offsetof(PackedVertex, UVCoord));
+				glEnableVertexAttribArray(attributes.UVCoord);
+			}
+		}));
+	}
+
+	Placement placement;
+	placement.arena = arena->arena.get();
+	placement.vertices = placement.arena->allocate_vertices(file.packed.size * sizeof(PackedVertex));
+	placement.indices = placement.arena->allocate_indices(file.index_bytes());
+	return placement;
+}
+
+void Meshes::finish_load(File &file, Placement const &placement) {
+	std::vector< uint32_t > hashes = hash_meshes(file);
+
+	//offset entries to where their data landed in the arena:
+	GLuint first_vertex = GLuint(placement.vertices.offset / sizeof(PackedVertex));
+	GLuint first_index = GLuint(placement.indices.offset / (file.short_indices.empty() ? sizeof(uint32_t) : sizeof(uint16_t)));
+	for (auto &entry : file.entries) {
+		entry.second.vao = placement.arena->vao;
+		entry.second.start += first_vertex;
+		entry.second.index_start += first_index;
+	}
+	add_meshes(file, hashes, placement);
+}
+
+//copy data into a range of a buffer by mapping the range, so it is written once, straight into the
+// buffer's storage (glBufferSubData may stage it in another copy first):
+static void write_range(GLuint buffer, GeometryArena::Range const &range, void const *data) {
+	if (range.size == 0) return;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	void *mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, range.offset, range.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	bool written = false;
+	if (mapped) {
+		std::memcpy(mapped, data, range.size);
+		written = (glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE);
+	}
+	if (!written) { //(the mapping failed, or its contents were lost)
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset, range.size, data);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Meshes::load(std::string const &filename, Attributes const &attributes, std::vector< std::string > const &only) {
+	File file = prepare_load(filename, only);
+	Placement placement = place(file, attributes);
+
+	//upload data (for cooked files, the vertices go straight from the mapped file to the mapped buffer):
+	write_range(placement.arena->vertex_buffer, placement.vertices, file.packed.data);
+	write_range(placement.arena->index_buffer, placement.indices, file.index_data());
+
+	finish_load(file, placement);
+}
+
+Meshes::File Meshes::prepare_load_cpu(std::string const &filename, std::vector< std::string > const &only) const {
+	File file;
+	file.read(filename);
+	if (!only.empty()) file.select(only);
+	file.dequantize(); //(the software path works in floats)
+	if (file.indices.empty()) {
+		file.weld();
+		if (optimize_on_load) file.optimize();
+	}
+	if (!file.has_bounds) file.compute_bounds();
+	for (auto &entry : file.entries) {
+		entry.second.index_type = GL_UNSIGNED_INT;
+	}
+	file.blob->wait_verified();
+	return file;
+}
+
+void Meshes::load_cpu(std::string const &filename, std::vector< std::string > const &only) {
+	File file = prepare_load_cpu(filename, only);
+	std::vector< uint32_t > hashes = hash_meshes(file);
+
+	//offset entries to where their data lands in cpu_vertices / cpu_indices:
+	for (auto &entry : file.entries) {
+		entry.second.start += cpu_vertices.size();
+		entry.second.index_start += cpu_indices.size();
+	}
+	cpu_vertices.insert(cpu_vertices.end(), file.floats.begin(), file.floats.end());
+	cpu_indices.insert(cpu_indices.end(), file.indices.begin(), file.indices.end());
+
+	add_meshes(file, hashes, Placement());
+}
+
+std::vector< MeshHandle > Meshes::reload(std::string const &filename) {
+	LoadedFile *loaded_file = nullptr;
+	for (auto &f : loaded_files) {
+		if (f.filename == filename) loaded_file = &f;
+	}
+	if (!loaded_file) {
+		throw std::runtime_error("Reloading '" + filename + "', which isn't loaded.");
+	}
+	GeometryArena *arena = loaded_file->placement.arena;
+	File file = (arena ? prepare_load(filename, loaded_file->only) : prepare_load_cpu(filename, loaded_file->only));
+	std::vector< uint32_t > hashes = hash_meshes(file);
+	LoadedFile &lf = *loaded_file;
+
+	std::vector< MeshHandle > changed;
+	uint32_t moved_count = 0;
+	for (uint32_t e = 0; e < file.entries.size(); ++e) {
+		std::string const &name = file.entries[e].first;
+		Mesh mesh = file.entries[e].second; //(offsets are still relative to the file's data)
+		MeshHandle handle = this->handle(name);
+		if (handle.index >= meshes.size()) {
+			meshes.resize(names.size());
+			loaded.resize(names.size(), false);
+		}
+		auto f = std::find_if(lf.handles.begin(), lf.handles.end(), [&handle](MeshHandle h){ return h.index == handle.index; });
+		Mesh const *old = nullptr;
+		if (f != lf.handles.end()) {
+			if (lf.hashes[f - lf.handles.begin()] == hashes[e]) continue; //(unchanged)
+			old = &meshes[handle.index];
+		} else if (loaded[handle.index]) {
+			std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			continue;
+		}
+		//(a mesh fits over its old data if it has no more vertices or indices, of the same type)
+		bool fits = old && mesh.count <= old->count && mesh.index_count <= old->index_count && mesh.index_type == old->index_type;
+
+		if (arena) {
+			size_t index_size = (mesh.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+			size_t vertex_bytes = mesh.count * sizeof(PackedVertex);
+			size_t index_bytes = mesh.index_count * index_size;
+			GLuint start, index_start;
+			if (fits) {
+				start = old->start;
+				index_start = old->index_start;
+			} else {
+				Placement moved;
+				moved.arena = arena;
+				moved.vertices = arena->allocate_vertices(vertex_bytes);
+				moved.indices = arena->allocate_indices(index_bytes);
+				lf.moved.emplace_back(moved);
+				start = GLuint(moved.vertices.offset / sizeof(PackedVertex));
+				index_start = GLuint(moved.indices.offset / index_size);
+				++moved_count;
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vertex_buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, start * sizeof(PackedVertex), vertex_bytes, file.packed.data + mesh.start);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena->index_buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, index_start * index_size, index_bytes, reinterpret_cast< uint8_t const * >(file.index_data()) + mesh.index_start * index_size);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			mesh.vao = arena->vao;
+			mesh.start = start;
+			mesh.index_start = index_start;
+		} else {
+			Vertex const *vertices = file.floats.data + mesh.start;
+			uint32_t const *indices = file.indices.data + mesh.index_start;
+			if (fits) {
+				std::copy(vertices, vertices + mesh.count, cpu_vertices.begin() + old->start);
+				std::copy(indices, indices + mesh.index_count, cpu_indices.begin() + old->index_start);
+				mesh.start = old->start;
+				mesh.index_start = old->index_start;
+			} else {
+				mesh.start = GLuint(cpu_vertices.size());
+				mesh.index_start = GLuint(cpu_indices.size());
+				cpu_vertices.insert(cpu_vertices.end(), vertices, vertices + mesh.count);
+				cpu_indices.insert(cpu_indices.end(), indices, indices + mesh.index_count);
+				++moved_count;
+			}
+		}
+
+		meshes[handle.index] = mesh;
+		loaded[handle.index] = true;
+		if (f != lf.handles.end()) {
+			lf.hashes[f - lf.handles.begin()] = hashes[e];
+		} else {
+			lf.handles.emplace_back(handle);
+			lf.hashes.emplace_back(hashes[e]);
+		}
+		changed.emplace_back(handle);
+	}
+
+	for (auto const &handle : lf.handles) {
+		bool found = std::any_of(file.entries.begin(), file.entries.end(), [&](std::pair< std::string, Mesh > const &entry){ return entry.first == names.name(handle.index); });
+		if (!found) {
+			std::cerr << "WARNING: mesh '" << names.name(handle.index) << "' is no longer in '" << filename << "'; keeping the old one." << std::endl;
+		}
+	}
+
+	std::cout << "Reloaded '" << filename << "': " << changed.size() << " of " << file.entries.size() << " meshes changed";
+	if (moved_count) std::cout << " (" << moved_count << " didn't fit in their old ranges)";
+	std::cout << "." << std::endl;
+	return changed;
 }
 
 Mesh const &Meshes::get(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
+	MeshHandle handle;
+	handle.index = names.find(name);
+	if (!has(handle)) {
 		throw std::runtime_error("Looking up mesh that doesn't exist.");
 	}
-	return f->second;
+	return meshes[handle.index];
+}
+
+void Meshes::throw_missing(MeshHandle handle) const {
+	if (handle.index < names.size()) {
+		throw std::runtime_error("Looking up mesh '" + names.name(handle.index) + "' that isn't loaded.");
+	}
+	throw std::runtime_error("Looking up mesh that doesn't exist.");
 }
@@ -1,19 +1,61 @@
 #pragma once
 
 #include "GL.hpp"
-#include <map>
+#include "GeometryArena.hpp"
+#include "MappedBlob.hpp"
+#include "NameTable.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
 
 //Mesh is a lightweight handle to some OpenGL vertex data:
 struct Mesh {
-	GLuint vao = 0;
-	GLuint start = 0;
-	GLuint count = 0;
-	//glm::vec3 max;
-	//glm::vec3 min;
+	GLuint vao = 0; //(shared by every mesh in the same GeometryArena) 0 for meshes loaded with load_cpu()
+	GLuint start = 0; //first vertex (the base vertex that indices are relative to)
+	GLuint count = 0; //number of vertices
+	//triangles are drawn from 'index_count' indices starting at 'index_start' (counted in indices, not bytes):
+	// (index_count == 0 means draw 'count' vertices in order, without indices)
+	GLuint index_start = 0;
+	GLuint index_count = 0;
+	GLenum index_type = GL_UNSIGNED_INT; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (load_cpu() always uses 32 bits)
+	//quantized vertex positions decode as box_min + Position * box_size (see Meshes::PackedVertex):
+	// (meshes loaded with load_cpu() are never quantized, so for those this is the identity)
+	glm::vec3 box_min = glm::vec3(0.0f);
+	glm::vec3 box_size = glm::vec3(1.0f);
+	//object-space bounds of the mesh's vertices (computed when loaded):
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	glm::vec3 sphere_center = glm::vec3(0.0f);
+	float sphere_radius = 0.0f;
+};
+
+//meshes are found by handle (a dense id from Meshes::names), so lookups are array indexing:
+struct BlobWriter;
+
+struct MeshHandle {
+	uint32_t index = NameTable::Invalid;
+	bool valid() const { return index != NameTable::Invalid; }
 };
 
 //"Meshes" loads a collection of meshes and builds VAOs for 'em
 // you pass in a 'Bindings' object to specify which attributes to bind where
+//
+//load() puts vertex and index data in a GeometryArena (one per set of attribute bindings), so meshes
+// from every file share one VAO and a few large buffers; unload() gives a file's ranges back.
+//
+//Mesh files store vertices either as floats ('v3n3' chunk, 32 bytes per vertex) or
+// quantized ('qv16' chunk, 16 bytes per vertex, with a 'box0' chunk of per-mesh bounds after the index).
+// load() always uploads the quantized format, converting float data as it loads, so the shader
+// must decode normals with the octahedral mapping and the mvp must include Mesh::box_min/box_size.
+//
+//Exported files store three vertices per triangle; both load() and load_cpu() weld identical vertices
+// (per mesh) and build index buffers, so shared vertices are stored (and transformed) once, then
+// reorder triangles and vertices with MeshOptimizer (see MeshOptimizer.hpp).
+//'cook' does the same work offline and writes versioned files (see MappedBlob.hpp) with an 'ix32'
+// index chunk and 'idx1' entries (which carry index ranges), and a 'bnd0' chunk of precomputed
+// Mesh bounds; those load as-is. (An AssetPackage holds the same chunks, so it loads as a mesh file.)
 
 struct Meshes {
 	struct Attributes {
@@ -22,13 +64,169 @@ struct Meshes {
 		GLuint UVCoord = -1U;
 	};
 	//add meshes from a file; use the indicated indices for attribute locations:
+	// if 'only' isn't empty, just the meshes it names are loaded (the file is mapped, so the data of
+	// the others is never read from disk).
+	// note: will throw if file fails to read.
+	void load(std::string const &filename, Attributes const &attributes, std::vector< std::string > const &only = std::vector< std::string >());
+
+	//add meshes from a file, keeping the vertex data in 'cpu_vertices' instead of uploading it
+	// (for rendering without a GPU; makes no OpenGL calls):
 	// note: will throw if file fails to read.
-	void load(std::string const &filename, Attributes const &attributes);
+	void load_cpu(std::string const &filename, std::vector< std::string > const &only = std::vector< std::string >());
+
+	struct File; //(below)
+	//where a file's data goes in the arena:
+	struct Placement {
+		GeometryArena *arena = nullptr;
+		GeometryArena::Range vertices; //for file.packed
+		GeometryArena::Range indices; //for file.index_data()
+	};
+	//load() in steps, for loading in the background (see AssetStreamer.hpp):
+	// prepare_load() does all the reading and processing and makes no OpenGL calls (safe on any thread);
+	// place() allocates room for the file's data in the arena for 'attributes';
+	// finish_load() adds the meshes, once the data has been copied to the placement's ranges.
+	File prepare_load(std::string const &filename, std::vector< std::string > const &only = std::vector< std::string >()) const;
+	Placement place(File const &file, Attributes const &attributes);
+	void finish_load(File &file, Placement const &placement);
+
+	//re-read a loaded file (as it was loaded: uploaded or not, with the same 'only'), updating just the
+	// meshes whose data changed (each mesh's data is hashed when loaded). A changed mesh is written over
+	// its old ranges if it fits there (as it does after small edits), and gets new ranges otherwise;
+	// meshes new to the file are added. Returns the handles of the meshes that changed or were added,
+	// so objects drawing them can pick up the new Mesh.
+	// note: will throw if the file fails to read (the meshes loaded before are left as they were).
+	std::vector< MeshHandle > reload(std::string const &filename);
+
+	//forget the meshes loaded from a file, returning their ranges to the arena:
+	// (scene objects must stop drawing them first; load_cpu() data stays in cpu_vertices / cpu_indices)
+	void unload(std::string const &filename);
+
+	//handle for a mesh name (the mesh need not be loaded yet, e.g. while it streams in):
+	MeshHandle handle(std::string const &name);
+
+	//is the mesh loaded?
+	bool has(MeshHandle handle) const {
+		return handle.index < loaded.size() && loaded[handle.index];
+	}
 
 	//look up a particular mesh in the DB:
+	// note: will throw if mesh not loaded.
+	Mesh const &get(MeshHandle handle) const {
+		if (!has(handle)) throw_missing(handle);
+		return meshes[handle.index];
+	}
+
+	//look up by name (hashes the name; meant for tools and setup code -- keep handles for anything frequent):
 	// note: will throw if mesh not found.
 	Mesh const &get(std::string const &name) const;
 
+	//vertex format stored in mesh files:
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::vec2 UVCoord;
+	};
+	static_assert(sizeof(Vertex) == 32, "Vertex is packed");
+
+	//quantized vertex format (what load() uploads):
+	struct PackedVertex {
+		uint16_t Position[4]; //unorm16 across the mesh's bounding box; [3] is padding
+		int16_t Normal[2]; //snorm16 octahedral encoding of the unit normal
+		uint16_t UVCoord[2]; //half floats
+	};
+	static_assert(sizeof(PackedVertex) == 16, "PackedVertex is packed");
+
+	//per-mesh bounds in 'box0' chunks (in index order):
+	struct Box {
+		glm::vec3 min;
+		glm::vec3 size;
+	};
+	static_assert(sizeof(Box) == 24, "Box is packed");
+
+	//per-mesh Mesh::bounds_* / sphere_* in 'bnd0' chunks of cooked files (in index order):
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 sphere_center;
+		float sphere_radius;
+	};
+	static_assert(sizeof(Bounds) == 40, "Bounds is packed");
+
+	//convert between formats (positions quantized relative to 'box'):
+	static PackedVertex pack(Vertex const &vertex, Box const &box);
+	static Vertex unpack(PackedVertex const &vertex, Box const &box);
+
+	//reorder triangles and vertices of (uncooked) files for the post-transform cache, overdraw, and fetch:
+	bool optimize_on_load = true;
+
+	//the contents of a mesh file, for processing before upload (used by load() and the 'cook' tool):
+	// data is viewed in place in the mapped file (see MappedBlob.hpp) until a step below changes it,
+	// after which it lives in the *_storage vectors.
+	struct File {
+		BlobSpan< Vertex > floats; //'v3n3' data, or empty if quantized
+		BlobSpan< PackedVertex > packed; //'qv16' data, or empty if not quantized
+		BlobSpan< uint32_t > indices; //empty until welded (or read from a cooked file); relative to Mesh::start
+		std::vector< std::pair< std::string, Mesh > > entries; //(vao is always zero)
+		std::string filename;
+		bool has_bounds = false; //entries' bounds are filled in (by compute_bounds() or from a 'bnd0' chunk)
+		std::vector< std::string > only; //names passed to select(), if it was called
+
+		std::shared_ptr< MappedBlob > blob;
+		std::vector< Vertex > float_storage;
+		std::vector< PackedVertex > packed_storage;
+		std::vector< uint32_t > index_storage;
+		std::vector< uint16_t > short_indices; //(filled by prepare_load() when every mesh fits)
+
+		File() = default;
+		File(File &&) = default;
+		File &operator=(File &&) = default;
+		File(File const &) = delete; //(spans may point into the storage vectors)
+
+		//note: will throw if file fails to read.
+		// chunk checksums are checked on ThreadPool::shared() while the steps below run; call
+		// blob->wait_verified() before using the data (prepare_load() and load_cpu() do).
+		void read(std::string const &filename);
+		//(or from a blob that is already open, e.g. one in memory):
+		void read(std::shared_ptr< MappedBlob > const &blob);
+		//write in the cooked format (optionally compressing the vertex and index data, see Compression.hpp):
+		// note: will throw if not quantized and indexed.
+		void write(std::string const &filename, bool compress = false) const;
+		//add the chunks write() writes to 'writer' (e.g., to put meshes in a bigger file):
+		void add_chunks(BlobWriter *writer, bool compress = false) const;
+
+		void select(std::vector< std::string > const &names); //drop all meshes but these (warns about missing names)
+		void quantize(); //floats -> packed (per-mesh boxes)
+		void dequantize(); //packed -> floats
+		void weld(); //build indices, merging identical vertices (prints savings)
+		void optimize(); //run MeshOptimizer on each mesh (prints ACMR/ATVR before and after)
+		void compute_bounds(); //fill in each mesh's bounds_min/max and sphere_center/radius (sets has_bounds)
+
+		//what load() uploads as the index buffer (16-bit indices if prepare_load() made them):
+		void const *index_data() const;
+		size_t index_bytes() const;
+	};
+
 	//internals:
-	std::map< std::string, Mesh > meshes;
+	NameTable names;
+	std::vector< Mesh > meshes; //by handle
+	std::vector< bool > loaded; //by handle
+	struct Arena {
+		Attributes attributes;
+		std::unique_ptr< GeometryArena > arena;
+	};
+	std::vector< Arena > arenas; //(clear() before the GL context goes away)
+	struct LoadedFile {
+		std::string filename;
+		std::vector< std::string > only;
+		std::vector< MeshHandle > handles;
+		std::vector< uint32_t > hashes; //CRC-32C of each mesh's vertices, indices, and box (by handles)
+		Placement placement; //(no arena for load_cpu())
+		std::vector< Placement > moved; //ranges reload() gave to meshes that outgrew their old ones
+	};
+	std::vector< LoadedFile > loaded_files;
+	File prepare_load_cpu(std::string const &filename, std::vector< std::string > const &only) const; //(load_cpu()'s processing)
+	void add_meshes(File const &file, std::vector< uint32_t > const &hashes, Placement const &placement); //(warns on name collisions)
+	[[noreturn]] void throw_missing(MeshHandle handle) const;
+	std::vector< Vertex > cpu_vertices; //vertex data of meshes added with load_cpu(); Mesh::start indexes this
+	std::vector< uint32_t > cpu_indices; //index data of meshes added with load_cpu(); Mesh::index_start indexes this
 };
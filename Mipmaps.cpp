@@ -0,0 +1,169 @@
+#include "Mipmaps.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MIPMAPS_SSE 1
+#include <emmintrin.h>
+#endif
+
+uint32_t mip_level_count(glm::uvec2 size) {
+	uint32_t count = 1;
+	while (size.x > 1 || size.y > 1) {
+		size = glm::max(size / 2U, glm::uvec2(1));
+		++count;
+	}
+	return count;
+}
+
+glm::uvec2 mip_level_size(glm::uvec2 size, uint32_t level) {
+	for (uint32_t l = 0; l < level; ++l) {
+		size = glm::max(size / 2U, glm::uvec2(1));
+	}
+	return size;
+}
+
+namespace {
+//conversion tables (shared by both paths, so they agree exactly):
+struct Tables {
+	float decode[256]; //sRGB-encoded byte -> linear
+	float alpha[256]; //byte -> [0,1]
+	uint8_t encode[4096]; //linear, in 4095ths -> sRGB-encoded byte
+	Tables() {
+		for (uint32_t i = 0; i < 256; ++i) {
+			float s = i / 255.0f;
+			decode[i] = (s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f));
+			alpha[i] = s;
+		}
+		for (uint32_t i = 0; i < 4096; ++i) {
+			float l = i / 4095.0f;
+			float s = (l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f);
+			encode[i] = uint8_t(std::min(std::max(s, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+};
+Tables const &tables() {
+	static Tables const t;
+	return t;
+}
+
+//linear RGBA as four floats, one channel at a time:
+struct ScalarOps {
+	struct Texel {
+		float c[4];
+	};
+	static Texel decode(uint32_t texel) {
+		Tables const &t = tables();
+		Texel ret = {{ t.decode[texel & 0xff], t.decode[(texel >> 8) & 0xff], t.decode[(texel >> 16) & 0xff], t.alpha[texel >> 24] }};
+		return ret;
+	}
+	static Texel load(float const *from) {
+		Texel ret = {{ from[0], from[1], from[2], from[3] }};
+		return ret;
+	}
+	static Texel add(Texel const &a, Texel const &b) {
+		Texel ret = {{ a.c[0] + b.c[0], a.c[1] + b.c[1], a.c[2] + b.c[2], a.c[3] + b.c[3] }};
+		return ret;
+	}
+	static Texel quarter(Texel const &a) {
+		Texel ret = {{ a.c[0] * 0.25f, a.c[1] * 0.25f, a.c[2] * 0.25f, a.c[3] * 0.25f }};
+		return ret;
+	}
+	static void store(Texel const &a, float *to) {
+		std::copy(a.c, a.c + 4, to);
+	}
+	static uint32_t encode(Texel const &a) {
+		Tables const &t = tables();
+		int32_t i[4];
+		for (uint32_t k = 0; k < 4; ++k) {
+			i[k] = int32_t(std::min(std::max(a.c[k], 0.0f), 1.0f) * (k < 3 ? 4095.0f : 255.0f) + 0.5f);
+		}
+		return uint32_t(t.encode[i[0]]) | (uint32_t(t.encode[i[1]]) << 8) | (uint32_t(t.encode[i[2]]) << 16) | (uint32_t(i[3]) << 24);
+	}
+};
+
+#ifdef MIPMAPS_SSE
+//the same, with the four channels in one register:
+struct SseOps {
+	typedef __m128 Texel;
+	static Texel decode(uint32_t texel) {
+		Tables const &t = tables();
+		return _mm_setr_ps(t.decode[texel & 0xff], t.decode[(texel >> 8) & 0xff], t.decode[(texel >> 16) & 0xff], t.alpha[texel >> 24]);
+	}
+	static Texel load(float const *from) {
+		return _mm_loadu_ps(from);
+	}
+	static Texel add(Texel a, Texel b) {
+		return _mm_add_ps(a, b);
+	}
+	static Texel quarter(Texel a) {
+		return _mm_mul_ps(a, _mm_set1_ps(0.25f));
+	}
+	static void store(Texel a, float *to) {
+		_mm_storeu_ps(to, a);
+	}
+	static uint32_t encode(Texel a) {
+		Tables const &t = tables();
+		a = _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128i scaled = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f)), _mm_set1_ps(0.5f)));
+		int32_t i[4];
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(i), scaled);
+		return uint32_t(t.encode[i[0]]) | (uint32_t(t.encode[i[1]]) << 8) | (uint32_t(t.encode[i[2]]) << 16) | (uint32_t(i[3]) << 24);
+	}
+};
+#endif
+
+//one level from the one before ('fetch(i)' gives texel i of it, linear):
+template< typename Ops, typename Fetch >
+void downsample(glm::uvec2 size, Fetch const &fetch, std::vector< float > *linear, std::vector< uint32_t > *texels) {
+	glm::uvec2 next = glm::max(size / 2U, glm::uvec2(1));
+	linear->resize(size_t(next.x) * next.y * 4);
+	texels->resize(size_t(next.x) * next.y);
+	for (uint32_t y = 0; y < next.y; ++y) {
+		uint32_t y0 = std::min(2 * y, size.y - 1) * size.x;
+		uint32_t y1 = std::min(2 * y + 1, size.y - 1) * size.x;
+		for (uint32_t x = 0; x < next.x; ++x) {
+			uint32_t x0 = std::min(2 * x, size.x - 1);
+			uint32_t x1 = std::min(2 * x + 1, size.x - 1);
+			typename Ops::Texel sum = Ops::add(
+				Ops::add(fetch(y0 + x0), fetch(y0 + x1)),
+				Ops::add(fetch(y1 + x0), fetch(y1 + x1))
+			);
+			typename Ops::Texel average = Ops::quarter(sum);
+			uint32_t i = y * next.x + x;
+			Ops::store(average, &(*linear)[4 * i]);
+			(*texels)[i] = Ops::encode(average);
+		}
+	}
+}
+
+template< typename Ops >
+std::vector< std::vector< uint32_t > > build(glm::uvec2 size, uint32_t const *level0) {
+	std::vector< std::vector< uint32_t > > levels(mip_level_count(size) - 1);
+	std::vector< float > prev, next; //linear texels of the level before / being made
+	for (uint32_t l = 0; l < levels.size(); ++l) {
+		if (l == 0) {
+			downsample< Ops >(size, [level0](uint32_t i){ return Ops::decode(level0[i]); }, &next, &levels[l]);
+		} else {
+			float const *from = prev.data();
+			downsample< Ops >(size, [from](uint32_t i){ return Ops::load(from + 4 * i); }, &next, &levels[l]);
+		}
+		std::swap(prev, next);
+		size = glm::max(size / 2U, glm::uvec2(1));
+	}
+	return levels;
+}
+}
+
+std::vector< std::vector< uint32_t > > make_mipmaps(glm::uvec2 size, uint32_t const *level0) {
+	#ifdef MIPMAPS_SSE
+	return build< SseOps >(size, level0);
+	#else
+	return build< ScalarOps >(size, level0);
+	#endif
+}
+
+std::vector< std::vector< uint32_t > > make_mipmaps_scalar(glm::uvec2 size, uint32_t const *level0) {
+	return build< ScalarOps >(size, level0);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+//Mipmap chains for RGBA8 textures (as load_png() gives them), built on the CPU so every texture gets
+// the same full chain whatever the driver (no glGenerateMipmap):
+// - each level is half the size of the one before (rounded down) until 1x1, and each texel is the
+//   box-filtered average of the 2x2 texels it covers (the last row / column repeats for odd sizes);
+// - averages are taken in linear light: RGB is decoded from sRGB (as the PNGs are stored) and encoded
+//   back (through a 4096-entry table), alpha is averaged as-is, so detail doesn't darken as it shrinks;
+// - each level is filtered from the one before it at float precision, with the four channels of a
+//   texel in one SSE register (SSE2 is always there on x86-64); make_mipmaps_scalar() gives the same
+//   results without SSE, for other CPUs and for checking.
+//Chains of different textures are independent, so callers build them in parallel, one job per texture.
+
+//number of levels in a full chain (including level 0):
+uint32_t mip_level_count(glm::uvec2 size);
+
+//size of level 'level' of a texture of 'size':
+glm::uvec2 mip_level_size(glm::uvec2 size, uint32_t level);
+
+//levels 1 and up of the chain for 'level0' ('size.x * size.y' texels):
+std::vector< std::vector< uint32_t > > make_mipmaps(glm::uvec2 size, uint32_t const *level0);
+std::vector< std::vector< uint32_t > > make_mipmaps_scalar(glm::uvec2 size, uint32_t const *level0);
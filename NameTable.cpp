@@ -0,0 +1,58 @@
+#include "NameTable.hpp"
+
+constexpr uint32_t NameTable::Invalid;
+
+uint32_t hash_name(char const *name, size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= uint8_t(name[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+uint32_t NameTable::find_slot(char const *name, size_t length, uint32_t hash) const {
+	uint32_t mask = uint32_t(slots.size()) - 1;
+	for (uint32_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+		uint32_t id = slots[slot];
+		if (id == Invalid) return slot;
+		if (hashes[id] == hash && names[id].compare(0, std::string::npos, name, length) == 0) return slot;
+	}
+}
+
+uint32_t NameTable::find(std::string const &name) const {
+	return find(name.data(), name.size());
+}
+
+uint32_t NameTable::find(char const *name, size_t length) const {
+	if (slots.empty()) return Invalid;
+	return slots[find_slot(name, length, hash_name(name, length))];
+}
+
+uint32_t NameTable::intern(std::string const &name) {
+	return intern(name.data(), name.size());
+}
+
+uint32_t NameTable::intern(char const *name, size_t length) {
+	//keep the table at most half full:
+	if (2 * (names.size() + 1) > slots.size()) grow();
+
+	uint32_t hash = hash_name(name, length);
+	uint32_t slot = find_slot(name, length, hash);
+	if (slots[slot] == Invalid) {
+		slots[slot] = uint32_t(names.size());
+		names.emplace_back(name, length);
+		hashes.emplace_back(hash);
+	}
+	return slots[slot];
+}
+
+void NameTable::grow() {
+	slots.assign(slots.empty() ? 16 : 2 * slots.size(), Invalid);
+	uint32_t mask = uint32_t(slots.size()) - 1;
+	for (uint32_t id = 0; id < names.size(); ++id) {
+		uint32_t slot = hashes[id] & mask;
+		while (slots[slot] != Invalid) slot = (slot + 1) & mask;
+		slots[slot] = id;
+	}
+}
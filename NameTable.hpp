@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//"NameTable" interns strings: each distinct name gets a dense 32-bit id (0, 1, 2, ... in order of
+// first use), found through an open-addressing hash table. Names are hashed once, when they are
+// interned or looked up; code that keeps the id can then index plain arrays with it.
+
+//FNV-1a:
+uint32_t hash_name(char const *name, size_t length);
+
+struct NameTable {
+	static constexpr uint32_t Invalid = -1U;
+
+	//id of 'name', adding it if it is new:
+	uint32_t intern(std::string const &name);
+	uint32_t intern(char const *name, size_t length); //(no std::string unless the name is new)
+
+	//id of 'name', or Invalid if it was never interned:
+	uint32_t find(std::string const &name) const;
+	uint32_t find(char const *name, size_t length) const;
+
+	//the name with a given id:
+	std::string const &name(uint32_t id) const { return names[id]; }
+
+	uint32_t size() const { return uint32_t(names.size()); }
+
+	//internals:
+	std::vector< std::string > names; //by id
+	std::vector< uint32_t > hashes; //by id (so growing doesn't rehash strings)
+	std::vector< uint32_t > slots; //ids, or Invalid for empty slots; size is zero or a power of two (linear probing)
+	uint32_t find_slot(char const *name, size_t length, uint32_t hash) const; //slot holding 'name', or the empty slot where it would go
+	void grow();
+};
@@ -0,0 +1,222 @@
+#include "RenderCommands.hpp"
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+void RenderCommands::clear() {
+	pipelines.clear();
+	commands.clear();
+	matrices.clear();
+}
+
+void RenderCommands::set_pipeline(Pipeline const &pipeline) {
+	uint32_t index = 0;
+	while (index < pipelines.size()) {
+		Pipeline const &p = pipelines[index];
+		if (p.program == pipeline.program && p.mvp == pipeline.mvp && p.itmv == pipeline.itmv && p.tex == pipeline.tex) break;
+		++index;
+	}
+	if (index == pipelines.size()) {
+		pipelines.emplace_back(pipeline);
+	}
+	commands.emplace_back(Command{SetPipeline, index, 0, 0});
+}
+
+void RenderCommands::bind_texture(uint32_t unit, uint32_t texture) {
+	commands.emplace_back(Command{BindTexture, unit, texture, 0});
+}
+
+void RenderCommands::set_matrices(glm::mat4 const &mvp, glm::mat3 const &itmv) {
+	uint32_t offset = matrices.size();
+	matrices.insert(matrices.end(), glm::value_ptr(mvp), glm::value_ptr(mvp) + 16);
+	matrices.insert(matrices.end(), glm::value_ptr(itmv), glm::value_ptr(itmv) + 9);
+	commands.emplace_back(Command{SetMatrices, offset, 0, 0});
+}
+
+void RenderCommands::draw(uint32_t vao, uint32_t start, uint32_t count) {
+	commands.emplace_back(Command{Draw, vao, start, count});
+}
+
+void RenderCommands::set_vertex_array(uint32_t vao, uint32_t index_type) {
+	commands.emplace_back(Command{SetVertexArray, vao, index_type, 0});
+}
+
+void RenderCommands::draw_indexed(uint32_t first_index, uint32_t index_count, uint32_t base_vertex) {
+	commands.emplace_back(Command{DrawIndexed, first_index, index_count, base_vertex});
+}
+
+void RenderCommands::save(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	write_chunk(file, "pip0", pipelines);
+	write_chunk(file, "mat0", matrices);
+	write_chunk(file, "cmd0", commands);
+	if (!file) {
+		throw std::runtime_error("Failed to write commands to '" + filename + "'.");
+	}
+}
+
+void RenderCommands::load(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	read_chunk(file, "pip0", &pipelines);
+	read_chunk(file, "mat0", &matrices);
+	read_chunk(file, "cmd0", &commands);
+
+	//check that commands only refer to things that exist:
+	bool have_vertex_array = false;
+	for (auto const &command : commands) {
+		if (command.opcode == SetPipeline) {
+			if (command.a >= pipelines.size()) {
+				throw std::runtime_error("command refers to out-of-range pipeline");
+			}
+		} else if (command.opcode == SetMatrices) {
+			if (!(command.a < command.a + 25 && command.a + 25 <= matrices.size())) {
+				throw std::runtime_error("command refers to out-of-range matrices");
+			}
+		} else if (command.opcode == SetVertexArray) {
+			if (command.b != GL_UNSIGNED_SHORT && command.b != GL_UNSIGNED_INT) {
+				throw std::runtime_error("command has unknown index type " + std::to_string(command.b));
+			}
+			have_vertex_array = true;
+		} else if (command.opcode == DrawIndexed) {
+			if (!have_vertex_array) {
+				throw std::runtime_error("indexed draw before any vertex array was set");
+			}
+			if (command.a + command.b < command.a) {
+				throw std::runtime_error("indexed draw has out-of-range indices");
+			}
+		} else if (command.opcode == Draw) {
+			if (command.b + command.c < command.b) {
+				throw std::runtime_error("draw has out-of-range vertices");
+			}
+		} else if (command.opcode != BindTexture) {
+			throw std::runtime_error("unknown command opcode " + std::to_string(command.opcode));
+		}
+	}
+}
+
+void validate_gl(RenderCommands const &list) {
+	for (auto const &pipeline : list.pipelines) {
+		if (!glIsProgram(pipeline.program)) {
+			throw std::runtime_error("commands use program " + std::to_string(pipeline.program) + ", which doesn't exist");
+		}
+	}
+
+	//vertices and indices each vertex array can reach (the fewest over its enabled attributes):
+	struct Reach {
+		uint64_t vertices = -1ULL;
+		uint64_t index_bytes = 0;
+	};
+	std::unordered_map< uint32_t, Reach > reaches;
+	GLint old_vertex_array = 0, old_array_buffer = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &old_vertex_array);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &old_array_buffer);
+	auto reach = [&reaches](uint32_t vao) -> Reach const & {
+		auto f = reaches.find(vao);
+		if (f != reaches.end()) return f->second;
+		if (vao == 0 || !glIsVertexArray(vao)) {
+			throw std::runtime_error("commands use vertex array " + std::to_string(vao) + ", which doesn't exist");
+		}
+		Reach r;
+		glBindVertexArray(vao);
+		GLint attribs = 0;
+		glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attribs);
+		for (GLint i = 0; i < attribs; ++i) {
+			GLint enabled = 0, buffer = 0, stride = 0, size = 0;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			if (!enabled) continue;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+			GLvoid *pointer = nullptr;
+			glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+			if (buffer == 0 || stride == 0) continue; //(not a layout this code records)
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+			uint64_t offset = uint64_t(reinterpret_cast< uintptr_t >(pointer));
+			r.vertices = std::min< uint64_t >(r.vertices, offset < uint64_t(size) ? (uint64_t(size) - offset) / stride : 0);
+		}
+		GLint elements = 0, size = 0;
+		glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elements);
+		if (elements) {
+			glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+			r.index_bytes = uint64_t(size);
+		}
+		return reaches.emplace(vao, r).first->second;
+	};
+
+	uint32_t vertex_array = 0; //from SetVertexArray
+	uint64_t index_size = 4;
+	try {
+		for (auto const &command : list.commands) {
+			if (command.opcode == RenderCommands::BindTexture) {
+				if (command.b != 0 && !glIsTexture(command.b)) {
+					throw std::runtime_error("commands bind texture " + std::to_string(command.b) + ", which doesn't exist");
+				}
+			} else if (command.opcode == RenderCommands::Draw) {
+				if (uint64_t(command.b) + command.c > reach(command.a).vertices) {
+					throw std::runtime_error("draw reads past the end of vertex array " + std::to_string(command.a));
+				}
+			} else if (command.opcode == RenderCommands::SetVertexArray) {
+				reach(command.a);
+				vertex_array = command.a;
+				index_size = (command.b == GL_UNSIGNED_SHORT ? 2 : 4);
+			} else if (command.opcode == RenderCommands::DrawIndexed) {
+				Reach const &r = reach(vertex_array);
+				if ((uint64_t(command.a) + command.b) * index_size > r.index_bytes || (command.b && command.c >= r.vertices)) {
+					throw std::runtime_error("indexed draw reads past the end of vertex array " + std::to_string(vertex_array));
+				}
+			}
+		}
+	} catch (...) {
+		glBindVertexArray(old_vertex_array);
+		glBindBuffer(GL_ARRAY_BUFFER, old_array_buffer);
+		throw;
+	}
+	glBindVertexArray(old_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, old_array_buffer);
+}
+
+void execute_gl(RenderCommands const &list) {
+	RenderCommands::Pipeline const *pipeline = nullptr;
+	GLuint vertex_array = 0; //from SetVertexArray
+	GLenum index_type = GL_UNSIGNED_INT;
+	GLuint bound_vertex_array = 0; //(Draw binds its own vertex array, so this can differ from vertex_array)
+	for (auto const &command : list.commands) {
+		if (command.opcode == RenderCommands::SetPipeline) {
+			pipeline = &list.pipelines[command.a];
+			glUseProgram(pipeline->program);
+		} else if (command.opcode == RenderCommands::BindTexture) {
+			glActiveTexture(GL_TEXTURE0 + command.a);
+			glBindTexture(GL_TEXTURE_2D, command.b);
+			if (pipeline && pipeline->tex != -1U) {
+				glUniform1i(pipeline->tex, command.a);
+			}
+		} else if (command.opcode == RenderCommands::SetMatrices) {
+			if (pipeline && pipeline->mvp != -1U) {
+				glUniformMatrix4fv(pipeline->mvp, 1, GL_FALSE, &list.matrices[command.a]);
+			}
+			if (pipeline && pipeline->itmv != -1U) {
+				glUniformMatrix3fv(pipeline->itmv, 1, GL_FALSE, &list.matrices[command.a + 16]);
+			}
+		} else if (command.opcode == RenderCommands::Draw) {
+			glBindVertexArray(command.a);
+			bound_vertex_array = command.a;
+			glDrawArrays(GL_TRIANGLES, command.b, command.c);
+		} else if (command.opcode == RenderCommands::SetVertexArray) {
+			vertex_array = command.a;
+			index_type = command.b;
+		} else if (command.opcode == RenderCommands::DrawIndexed) {
+			if (bound_vertex_array != vertex_array) {
+				glBindVertexArray(vertex_array);
+				bound_vertex_array = vertex_array;
+			}
+			GLsizeiptr index_size = (index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.b, index_type, (GLbyte *)0 + command.a * index_size, command.c);
+		}
+	}
+}
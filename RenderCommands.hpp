@@ -0,0 +1,70 @@
+#pragma once
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//"RenderCommands" is a compact list of OpenGL drawing commands for one frame.
+// Scene::record() fills one in and execute_gl() (below) plays it back.
+// Command lists can be saved to and loaded from a file, so a captured frame can be replayed
+// many times (e.g., in a benchmark) without running the game.
+// note: this is a capture format for the OpenGL path only (SoftwareRenderer draws the Scene directly):
+//  programs, textures, and vertex arrays are OpenGL names, and uniform locations and index types are
+//  OpenGL's, so a saved list is only meaningful in a process that created its resources in the same
+//  order as the one that recorded it. validate_gl() checks that before a replay.
+
+struct RenderCommands {
+	struct Pipeline {
+		uint32_t program = 0;
+		uint32_t mvp = -1U; //uniform location of object-to-clip matrix
+		uint32_t itmv = -1U; //uniform location of inverse-transpose modelview matrix
+		uint32_t tex = -1U; //uniform location of texture sampler
+	};
+	static_assert(sizeof(Pipeline) == 16, "Pipeline is packed");
+
+	enum Opcode : uint32_t {
+		SetPipeline = 1, //a: index into pipelines
+		BindTexture = 2, //a: texture unit, b: texture
+		SetMatrices = 3, //a: offset into matrices (16 floats of mvp, then 9 floats of itmv)
+		Draw = 4, //a: vertex array, b: first vertex, c: vertex count
+		SetVertexArray = 5, //a: vertex array, b: index type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+		DrawIndexed = 6, //a: first index, b: index count, c: base vertex (from the last SetVertexArray)
+	};
+	struct Command {
+		uint32_t opcode;
+		uint32_t a, b, c;
+	};
+	static_assert(sizeof(Command) == 16, "Command is packed");
+
+	std::vector< Pipeline > pipelines;
+	std::vector< Command > commands;
+	std::vector< float > matrices;
+
+	void clear();
+
+	//helpers to append commands:
+	// (set_pipeline adds 'pipeline' to the pipelines list if it isn't there already)
+	void set_pipeline(Pipeline const &pipeline);
+	void bind_texture(uint32_t unit, uint32_t texture);
+	void set_matrices(glm::mat4 const &mvp, glm::mat3 const &itmv);
+	void draw(uint32_t vao, uint32_t start, uint32_t count);
+	void set_vertex_array(uint32_t vao, uint32_t index_type);
+	void draw_indexed(uint32_t first_index, uint32_t index_count, uint32_t base_vertex);
+
+	//file is chunks "pip0", "mat0", "cmd0" (see read_chunk.hpp):
+	// note: will throw on failure (including malformed commands; see also validate_gl()).
+	void save(std::string const &filename) const;
+	void load(std::string const &filename);
+};
+
+//check that loaded commands only name OpenGL objects that exist here, and that every draw stays
+// inside the buffers of its vertex array (so a list from another run, or a corrupt one, can't draw
+// out of range); call with all meshes resident:
+// note: will throw if not.
+void validate_gl(RenderCommands const &commands);
+
+//play back commands with OpenGL:
+void execute_gl(RenderCommands const &commands);
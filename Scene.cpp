@@ -4,6 +4,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <cassert>
 
 glm::mat4 Scene::Transform::make_local_to_parent() const {
 	return glm::mat4( //translate
@@ -57,6 +58,23 @@ glm::mat4 Scene::Transform::make_world_to_local() const {
 	}
 }
 
+Scene::Transform::Transform(Transform &&from) noexcept : position(from.position), rotation(from.rotation), scale(from.scale) {
+	//take 'from's place among its siblings:
+	parent = from.parent;
+	prev_sibling = from.prev_sibling;
+	next_sibling = from.next_sibling;
+	if (prev_sibling) prev_sibling->next_sibling = this;
+	if (next_sibling) next_sibling->prev_sibling = this;
+	else if (parent) parent->last_child = this;
+	//...and adopt its children:
+	last_child = from.last_child;
+	for (Transform *child = last_child; child; child = child->prev_sibling) {
+		child->parent = this;
+	}
+	from.parent = from.last_child = from.prev_sibling = from.next_sibling = nullptr;
+	DEBUG_assert_valid_pointers();
+}
+
 void Scene::Transform::DEBUG_assert_valid_pointers() const {
 	if (parent == nullptr) {
 		//if no parent, can't have siblings:
@@ -107,7 +125,10 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //---------------------------
 
-void Scene::render() {
+void Scene::record(RenderCommands *commands_) const {
+	assert(commands_);
+	RenderCommands &commands = *commands_;
+
 	glm::mat4 world_to_camera = camera.transform.make_world_to_local();
 	glm::mat4 world_to_clip = camera.make_projection() * world_to_camera;
 
@@ -117,11 +138,26 @@ void Scene::render() {
 		(void)mv;
 	}
 
+	RenderCommands::Pipeline current_pipeline;
+	bool have_pipeline = false;
+	int current_unit = -1;
+	GLuint current_tex = 0;
+	GLuint current_vao = 0;
+	GLenum current_index_type = 0;
+
 	for (auto const &object : objects) {
+		if (object.pending_assets) continue;
 		glm::mat4 local_to_world = object.transform.make_local_to_world();
 
 		//compute modelview+projection (object space to clip space) matrix for this object:
-		glm::mat4 mvp = world_to_clip * local_to_world;
+		// (folding in the mapping from quantized vertex positions to object space)
+		glm::mat4 dequantize = glm::mat4(
+			glm::vec4(object.box_size.x, 0.0f, 0.0f, 0.0f),
+			glm::vec4(0.0f, object.box_size.y, 0.0f, 0.0f),
+			glm::vec4(0.0f, 0.0f, object.box_size.z, 0.0f),
+			glm::vec4(object.box_min, 1.0f)
+		);
+		glm::mat4 mvp = world_to_clip * local_to_world * dequantize;
 
 		//compute modelview (object space to camera local space) matrix for this object:
 		glm::mat4 mv = world_to_camera * local_to_world;
@@ -130,21 +166,42 @@ void Scene::render() {
 		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
 
 		//set up program uniforms:
-		glUseProgram(object.program);
-		if (object.program_mvp != -1U) {
-			glUniformMatrix4fv(object.program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
-		}
-		if (object.program_itmv != -1U) {
-			glUniformMatrix3fv(object.program_itmv, 1, GL_FALSE, glm::value_ptr(itmv));
+		RenderCommands::Pipeline pipeline;
+		pipeline.program = object.program;
+		pipeline.mvp = object.program_mvp;
+		pipeline.itmv = object.program_itmv;
+		pipeline.tex = object.program_tex;
+		if (!have_pipeline || pipeline.program != current_pipeline.program || pipeline.mvp != current_pipeline.mvp
+		 || pipeline.itmv != current_pipeline.itmv || pipeline.tex != current_pipeline.tex) {
+			commands.set_pipeline(pipeline);
+			current_pipeline = pipeline;
+			have_pipeline = true;
+			current_unit = -1; //sampler uniform is per-program, so re-send texture binding
 		}
+		commands.set_matrices(mvp, itmv);
 
-		glActiveTexture(GL_TEXTURE0 + object.texture_used);
-		glBindTexture(GL_TEXTURE_2D, object.tex);
-		glUniform1i(object.program_tex, object.texture_used);
-		
-		glBindVertexArray(object.vao);
+		if (object.texture_used != current_unit || object.tex != current_tex) {
+			commands.bind_texture(object.texture_used, object.tex);
+			current_unit = object.texture_used;
+			current_tex = object.tex;
+		}
 
 		//draw the object:
-		glDrawArrays(GL_TRIANGLES, object.start, object.count);
+		if (object.index_count) {
+			if (object.vao != current_vao || object.index_type != current_index_type) {
+				commands.set_vertex_array(object.vao, object.index_type);
+				current_vao = object.vao;
+				current_index_type = object.index_type;
+			}
+			commands.draw_indexed(object.index_start, object.index_count, object.start);
+		} else {
+			commands.draw(object.vao, object.start, object.count);
+		}
 	}
 }
+
+void Scene::render() {
+	commands.clear();
+	record(&commands);
+	execute_gl(commands);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GL.hpp"
+#include "RenderCommands.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <vector>
@@ -13,6 +14,8 @@ struct Scene {
 	struct Transform {
 		Transform() = default;
 		Transform(Transform &) = delete;
+		//take over 'from's place in the hierarchy (so objects can live in a std::vector):
+		Transform(Transform &&from) noexcept;
 		~Transform() {
 			while (last_child) {
 				last_child->set_parent(nullptr);
@@ -61,6 +64,17 @@ struct Scene {
 		GLuint vao = 0;
 		GLuint start = 0;
 		GLuint count = 0;
+		GLuint index_start = 0; //(index_count == 0 draws 'count' vertices from 'start' without indices)
+		GLuint index_count = 0;
+		GLenum index_type = GL_UNSIGNED_INT;
+		//vertex positions decode to object space as box_min + Position * box_size (copied from Mesh):
+		glm::vec3 box_min = glm::vec3(0.0f);
+		glm::vec3 box_size = glm::vec3(1.0f);
+		//object-space bounds, for culling and collision (copied from Mesh):
+		glm::vec3 bounds_min = glm::vec3(0.0f);
+		glm::vec3 bounds_max = glm::vec3(0.0f);
+		glm::vec3 sphere_center = glm::vec3(0.0f);
+		float sphere_radius = 0.0f;
 		//program info:
 		GLuint program = 0;
 		GLuint program_mvp = -1U; //uniform index for MVP matrix
@@ -71,6 +85,9 @@ struct Scene {
 		int texture_used;
 
 		glm::vec3 dimension;
+
+		//mesh / texture requests still streaming in (see AssetStreamer); the object isn't drawn until this is zero:
+		uint32_t pending_assets = 0;
 	};
 	struct Light {
 		Transform transform;
@@ -79,8 +96,17 @@ struct Scene {
 	};
 
 	Camera camera;
-	std::list< Object > objects;
+	//(growing this moves objects -- hierarchy links follow, but pointers held elsewhere don't -- so reserve()
+	// room for every object before adding them, e.g. with load_scene() from SceneLoader.hpp)
+	std::vector< Object > objects;
 	std::list< Light > lights;
 
+	//append the commands needed to draw the scene (skips redundant pipeline / texture changes):
+	void record(RenderCommands *commands) const;
+
+	//draw the scene with OpenGL (records into 'commands', then executes them):
 	void render();
+
+	//commands from the most recent render():
+	RenderCommands commands;
 };
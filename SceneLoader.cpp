@@ -0,0 +1,86 @@
+#include "SceneLoader.hpp"
+#include "AssetPackage.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+LoadedScene load_scene(MappedBlob &file, std::string const &strings_magic, NameTable *names, std::function< bool(uint32_t id) > const &wanted, Scene *scene) {
+	BlobSpan< char > strings = file.find_chunk< char >(strings_magic);
+	BlobSpan< AssetPackage::SceneEntry > entries = file.find_chunk< AssetPackage::SceneEntry >("scn0");
+	BlobSpan< uint32_t > parents;
+	if (file.has_chunk("prn0")) {
+		parents = file.find_chunk< uint32_t >("prn0");
+		if (parents.size != entries.size) {
+			throw std::runtime_error("'" + file.filename + "' has " + std::to_string(parents.size) + " parents for " + std::to_string(entries.size) + " scene entries");
+		}
+	}
+
+	LoadedScene loaded;
+
+	//resolve names:
+	enum : uint8_t { Unasked, Wanted, Unwanted };
+	std::vector< uint8_t > verdicts; //by name id
+	std::vector< uint32_t > unwanted; //name ids, in order of first use
+	std::vector< uint32_t > added; //entry indices
+	loaded.ids.reserve(entries.size);
+	added.reserve(entries.size);
+	for (uint32_t i = 0; i < entries.size; ++i) {
+		AssetPackage::SceneEntry const &entry = entries[i];
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size)) {
+			throw std::runtime_error("'" + file.filename + "' has an entry with out-of-range name begin/end");
+		}
+		uint32_t id = names->intern(strings.data + entry.name_begin, entry.name_end - entry.name_begin);
+		if (id >= verdicts.size()) verdicts.resize(names->size(), Unasked);
+		if (verdicts[id] == Unasked) {
+			verdicts[id] = (wanted(id) ? Wanted : Unwanted);
+			if (verdicts[id] == Unwanted) unwanted.emplace_back(id);
+		}
+		if (verdicts[id] == Wanted) {
+			loaded.ids.emplace_back(id);
+			added.emplace_back(i);
+		} else {
+			++loaded.skipped;
+		}
+	}
+
+	//build objects:
+	loaded.first = scene->objects.size();
+	scene->objects.reserve(loaded.first + added.size());
+	for (uint32_t i : added) {
+		AssetPackage::SceneEntry const &entry = entries[i];
+		scene->objects.emplace_back();
+		Scene::Object &object = scene->objects.back();
+		object.transform.position = entry.position;
+		object.transform.rotation = entry.rotation;
+		object.transform.scale = entry.scale;
+		object.dimension = entry.dimension;
+	}
+
+	//parent objects (once they are all in place, since pointers into scene.objects are only stable after the reserve()):
+	if (!parents.empty()) {
+		std::vector< uint32_t > entry_object(entries.size, -1U); //index into added, by entry index
+		for (uint32_t a = 0; a < added.size(); ++a) {
+			entry_object[added[a]] = a;
+		}
+		for (uint32_t a = 0; a < added.size(); ++a) {
+			uint32_t parent = parents[added[a]];
+			if (parent == -1U) continue;
+			if (parent >= added[a]) {
+				throw std::runtime_error("'" + file.filename + "' has a scene entry whose parent doesn't come before it");
+			}
+			if (entry_object[parent] == -1U) continue; //(parent was skipped; the object stays, unparented)
+			scene->objects[loaded.first + a].transform.set_parent(&scene->objects[loaded.first + entry_object[parent]].transform);
+		}
+	}
+
+	if (!unwanted.empty()) {
+		std::cerr << "WARNING: skipped " << loaded.skipped << " objects in '" << file.filename << "' with unknown names:";
+		for (uint32_t u = 0; u < unwanted.size() && u < 10; ++u) {
+			std::cerr << " '" << names->name(unwanted[u]) << "'";
+		}
+		if (unwanted.size() > 10) std::cerr << " (and " << (unwanted.size() - 10) << " more)";
+		std::cerr << "." << std::endl;
+	}
+
+	return loaded;
+}
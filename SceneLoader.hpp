@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "MappedBlob.hpp"
+#include "NameTable.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//"load_scene" adds the objects of a scene file -- 'scn0' entries (see AssetPackage::SceneEntry) with
+// names in a strings chunk, as in scene.blob or an AssetPackage -- to a Scene in bulk:
+// - one pass over the entries resolves every name to an id in a NameTable straight from the strings
+//   chunk (no std::string per entry), asking 'wanted' about each distinct name once;
+// - scene.objects grows once, to fit every object, then the objects are built in one linear sweep
+//   (position, rotation, scale, and dimension; the caller fills in the rest, e.g. meshes and textures);
+// - if there is a 'prn0' chunk, objects are parented as it says (positions are then relative to the parent).
+//Entries with unwanted names (say, no mesh or material) are skipped and reported in one warning.
+
+struct LoadedScene {
+	size_t first = 0; //scene.objects[first + i] was made from the i'th added entry (in file order)
+	std::vector< uint32_t > ids; //name id of each added object
+	uint32_t skipped = 0; //entries with unwanted names
+};
+
+// note: will throw if the chunks are missing or a name or parent is out of range.
+LoadedScene load_scene(MappedBlob &file, std::string const &strings_magic, NameTable *names, std::function< bool(uint32_t id) > const &wanted, Scene *scene);
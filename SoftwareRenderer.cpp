@@ -0,0 +1,387 @@
+#include "SoftwareRenderer.hpp"
+#include "Mipmaps.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SOFTWARE_RENDERER_SSE 1
+#include <emmintrin.h>
+#endif
+
+constexpr uint32_t SoftwareRenderer::TileSize;
+constexpr uint32_t SoftwareRenderer::ObjectBatch;
+
+SoftwareRenderer::SoftwareRenderer(glm::uvec2 const &size_, ThreadPool *pool_) : size(size_), pool(pool_) {
+	color.resize(size.x * size.y, 0);
+	depth.resize(size.x * size.y, 1.0f);
+	tile_count = glm::uvec2((size.x + TileSize - 1) / TileSize, (size.y + TileSize - 1) / TileSize);
+	tiles.resize(tile_count.x * tile_count.y);
+	tile_texture_cache.resize(tiles.size());
+}
+
+static uint32_t pack_rgba8(glm::vec4 const &c) {
+	auto to_u8 = [](float f) -> uint32_t {
+		return uint32_t(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+	};
+	return to_u8(c.x) | (to_u8(c.y) << 8) | (to_u8(c.z) << 16) | (to_u8(c.w) << 24);
+}
+
+static glm::vec4 unpack_rgba8(uint32_t c) {
+	return glm::vec4(
+		(c & 0xff) / 255.0f,
+		((c >> 8) & 0xff) / 255.0f,
+		((c >> 16) & 0xff) / 255.0f,
+		(c >> 24) / 255.0f
+	);
+}
+
+namespace {
+	typedef SoftwareRenderer::ClipVertex ClipVertex;
+	ClipVertex lerp(ClipVertex const &a, ClipVertex const &b, float t) {
+		ClipVertex ret;
+		ret.clip = a.clip + (b.clip - a.clip) * t;
+		ret.normal = a.normal + (b.normal - a.normal) * t;
+		ret.uvcoord = a.uvcoord + (b.uvcoord - a.uvcoord) * t;
+		return ret;
+	}
+}
+
+//clip a triangle against the near plane (z >= -w), then set up the resulting triangle(s) for rasterization:
+static void setup_triangle(ClipVertex const tri[3], uint32_t texture, glm::uvec2 const &size, std::vector< SoftwareRenderer::Triangle > *out) {
+	ClipVertex poly[4];
+	uint32_t poly_count = 0;
+	for (uint32_t i = 0; i < 3; ++i) {
+		ClipVertex const &a = tri[i];
+		ClipVertex const &b = tri[(i + 1) % 3];
+		float da = a.clip.z + a.clip.w;
+		float db = b.clip.z + b.clip.w;
+		if (da >= 0.0f) poly[poly_count++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f)) poly[poly_count++] = lerp(a, b, da / (da - db));
+	}
+	if (poly_count < 3) return;
+
+	//project to window coordinates:
+	glm::vec2 window[4];
+	float depth[4], inv_w[4];
+	for (uint32_t i = 0; i < poly_count; ++i) {
+		inv_w[i] = 1.0f / poly[i].clip.w;
+		window[i] = glm::vec2(
+			(poly[i].clip.x * inv_w[i] * 0.5f + 0.5f) * size.x,
+			(poly[i].clip.y * inv_w[i] * 0.5f + 0.5f) * size.y
+		);
+		depth[i] = poly[i].clip.z * inv_w[i] * 0.5f + 0.5f;
+	}
+
+	for (uint32_t f = 1; f + 1 < poly_count; ++f) { //triangle fan
+		uint32_t idx[3] = { 0, f, f + 1 };
+		SoftwareRenderer::Triangle t;
+		glm::vec2 lo = window[idx[0]], hi = window[idx[0]];
+		for (uint32_t k = 0; k < 3; ++k) {
+			t.position[k] = window[idx[k]];
+			t.depth[k] = depth[idx[k]];
+			t.inv_w[k] = inv_w[idx[k]];
+			t.normal[k] = poly[idx[k]].normal * inv_w[idx[k]];
+			t.uvcoord[k] = poly[idx[k]].uvcoord * inv_w[idx[k]];
+			lo = glm::min(lo, t.position[k]);
+			hi = glm::max(hi, t.position[k]);
+		}
+		//pixels whose centers (x + 0.5, y + 0.5) are within the bounding box:
+		t.min = glm::ivec2(
+			std::max(0, int32_t(std::ceil(lo.x - 0.5f))),
+			std::max(0, int32_t(std::ceil(lo.y - 0.5f)))
+		);
+		t.max = glm::ivec2(
+			std::min(int32_t(size.x) - 1, int32_t(std::floor(hi.x - 0.5f))),
+			std::min(int32_t(size.y) - 1, int32_t(std::floor(hi.y - 0.5f)))
+		);
+		if (t.min.x > t.max.x || t.min.y > t.max.y) continue;
+
+		glm::vec2 const &p0 = t.position[0], &p1 = t.position[1], &p2 = t.position[2];
+		float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+		if (area == 0.0f) continue;
+		//edge k is opposite vertex k; oriented so the interior is positive:
+		float sign = (area > 0.0f ? 1.0f : -1.0f);
+		for (uint32_t k = 0; k < 3; ++k) {
+			glm::vec2 const &a = t.position[(k + 1) % 3];
+			glm::vec2 const &b = t.position[(k + 2) % 3];
+			t.edge_a[k] = sign * (a.y - b.y);
+			t.edge_b[k] = sign * (b.x - a.x);
+			t.edge_c[k] = -(t.edge_a[k] * a.x + t.edge_b[k] * a.y);
+			t.top_left[k] = (t.edge_a[k] > 0.0f || (t.edge_a[k] == 0.0f && t.edge_b[k] < 0.0f));
+		}
+		t.inv_area = 1.0f / (sign * area);
+		//barycentric weight k is edge function k * inv_area, which changes by edge_a[k] per pixel in x (edge_b[k] in y):
+		t.uvcoord_dx = t.uvcoord_dy = glm::vec2(0.0f);
+		t.inv_w_dx = t.inv_w_dy = 0.0f;
+		for (uint32_t k = 0; k < 3; ++k) {
+			t.uvcoord_dx += t.uvcoord[k] * (t.edge_a[k] * t.inv_area);
+			t.uvcoord_dy += t.uvcoord[k] * (t.edge_b[k] * t.inv_area);
+			t.inv_w_dx += t.inv_w[k] * (t.edge_a[k] * t.inv_area);
+			t.inv_w_dy += t.inv_w[k] * (t.edge_b[k] * t.inv_area);
+		}
+		t.texture = texture;
+		out->emplace_back(t);
+	}
+}
+
+void SoftwareRenderer::render(Scene const &scene, Meshes const &meshes) {
+	glm::mat4 world_to_camera = scene.camera.transform.make_world_to_local();
+	glm::mat4 world_to_clip = scene.camera.make_projection() * world_to_camera;
+
+	std::vector< Scene::Object const * > objects;
+	objects.reserve(scene.objects.size());
+	uint32_t largest_mesh = 0;
+	for (auto const &object : scene.objects) {
+		if (object.pending_assets) continue;
+		objects.emplace_back(&object);
+		largest_mesh = std::max(largest_mesh, object.count);
+	}
+	object_triangles.resize(objects.size());
+
+	//one transformed-vertex buffer per lane (each worker, plus the calling thread), reused for every object it takes:
+	lane_vertices.resize(pool ? pool->size() + 1 : 1);
+	for (auto &vertices : lane_vertices) {
+		if (vertices.size() < largest_mesh) vertices.resize(largest_mesh);
+	}
+
+	//transform, clip, and set up triangles (per object):
+	auto process_object = [&](uint32_t i, std::vector< ClipVertex > &transformed) {
+		Scene::Object const &object = *objects[i];
+		std::vector< Triangle > &out = object_triangles[i];
+		out.clear();
+		if (object.start + object.count > meshes.cpu_vertices.size()) return; //not CPU-side data
+		if (object.index_count && object.index_start + object.index_count > meshes.cpu_indices.size()) return;
+
+		glm::mat4 local_to_world = object.transform.make_local_to_world();
+		glm::mat4 mvp = world_to_clip * local_to_world;
+		glm::mat4 mv = world_to_camera * local_to_world;
+		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
+
+		//transform each vertex once:
+		Meshes::Vertex const *vertices = &meshes.cpu_vertices[0] + object.start;
+		for (uint32_t v = 0; v < object.count; ++v) {
+			transformed[v].clip = mvp * glm::vec4(vertices[v].Position, 1.0f);
+			transformed[v].normal = itmv * vertices[v].Normal;
+			transformed[v].uvcoord = vertices[v].UVCoord;
+		}
+
+		//assemble triangles:
+		uint32_t corners = (object.index_count ? object.index_count : object.count);
+		uint32_t const *indices = (object.index_count ? &meshes.cpu_indices[0] + object.index_start : nullptr);
+		for (uint32_t v = 0; v + 2 < corners; v += 3) {
+			ClipVertex tri[3];
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t index = (indices ? indices[v + k] : v + k);
+				if (index >= object.count) return; //(bad index; skip the rest of the object)
+				tri[k] = transformed[index];
+			}
+			setup_triangle(tri, object.texture_used, size, &out);
+		}
+	};
+	if (pool) {
+		//each lane pulls small batches of objects until none are left:
+		std::atomic< uint32_t > next(0);
+		pool->parallel_for(lane_vertices.size(), [&](uint32_t lane){
+			for (uint32_t begin = next.fetch_add(ObjectBatch); begin < objects.size(); begin = next.fetch_add(ObjectBatch)) {
+				uint32_t end = std::min< uint32_t >(begin + ObjectBatch, objects.size());
+				for (uint32_t i = begin; i < end; ++i) process_object(i, lane_vertices[lane]);
+			}
+		});
+	} else {
+		for (uint32_t i = 0; i < objects.size(); ++i) process_object(i, lane_vertices[0]);
+	}
+
+	//bin triangles into tiles (in draw order, so blending matches OpenGL):
+	for (auto &tile : tiles) {
+		tile.clear();
+	}
+	for (auto const &triangles : object_triangles) {
+		for (auto const &t : triangles) {
+			for (int32_t ty = t.min.y / int32_t(TileSize); ty <= t.max.y / int32_t(TileSize); ++ty) {
+				for (int32_t tx = t.min.x / int32_t(TileSize); tx <= t.max.x / int32_t(TileSize); ++tx) {
+					tiles[ty * tile_count.x + tx].emplace_back(&t);
+				}
+			}
+		}
+	}
+
+	if (pool) {
+		pool->parallel_for(tiles.size(), [this](uint32_t tile){ rasterize_tile(tile); });
+	} else {
+		for (uint32_t tile = 0; tile < tiles.size(); ++tile) rasterize_tile(tile);
+	}
+
+	if (measure_texture_cache) {
+		for (auto const &stats : tile_texture_cache) {
+			texture_cache.pixels += stats.pixels;
+			texture_cache.fetches += stats.fetches;
+			texture_cache.misses += stats.misses;
+		}
+	}
+}
+
+namespace {
+	//simulated cache for texel fetches (see SoftwareRenderer::measure_texture_cache):
+	struct TexelCache {
+		static constexpr uint32_t Lines = 256; //16KB of 64-byte lines
+		uintptr_t tags[Lines]; //line address + 1 (0 is empty)
+		SoftwareRenderer::TextureCacheStats *stats;
+	};
+}
+
+static glm::vec4 fetch(uint32_t const *texels, uint32_t index, TexelCache *cache) {
+	if (cache) {
+		uintptr_t line = reinterpret_cast< uintptr_t >(texels + index) / 64;
+		uintptr_t &tag = cache->tags[line % TexelCache::Lines];
+		++cache->stats->fetches;
+		if (tag != line + 1) {
+			tag = line + 1;
+			++cache->stats->misses;
+		}
+	}
+	return unpack_rgba8(texels[index]);
+}
+
+//GL_LINEAR sampling of one level, clamped to the edge:
+static glm::vec4 sample_linear(uint32_t const *texels, glm::uvec2 size, glm::vec2 uv, TexelCache *cache) {
+	float sx = std::min(std::max(uv.x * size.x - 0.5f, -1.0f), float(size.x));
+	float sy = std::min(std::max(uv.y * size.y - 0.5f, -1.0f), float(size.y));
+	float fx = std::floor(sx), fy = std::floor(sy);
+	int32_t x0 = std::min(std::max(int32_t(fx), 0), int32_t(size.x) - 1);
+	int32_t x1 = std::min(std::max(int32_t(fx) + 1, 0), int32_t(size.x) - 1);
+	int32_t y0 = std::min(std::max(int32_t(fy), 0), int32_t(size.y) - 1);
+	int32_t y1 = std::min(std::max(int32_t(fy) + 1, 0), int32_t(size.y) - 1);
+	glm::vec4 a = fetch(texels, y0 * size.x + x0, cache), b = fetch(texels, y0 * size.x + x1, cache);
+	glm::vec4 c = fetch(texels, y1 * size.x + x0, cache), d = fetch(texels, y1 * size.x + x1, cache);
+	return glm::mix(glm::mix(a, b, sx - fx), glm::mix(c, d, sx - fx), sy - fy);
+}
+
+//sample as OpenGL would with the filters AssetStreamer sets: GL_NEAREST without mipmaps; with them,
+// GL_LINEAR_MIPMAP_LINEAR when minified and GL_LINEAR when magnified, by the derivatives of uv:
+static glm::vec4 sample(SoftwareRenderer::Texture const &texture, glm::vec2 uv, glm::vec2 uv_dx, glm::vec2 uv_dy, TexelCache *cache) {
+	if (texture.mipmaps.empty()) {
+		int32_t tx = std::min(std::max(int32_t(std::floor(uv.x * texture.size.x)), 0), int32_t(texture.size.x) - 1);
+		int32_t ty = std::min(std::max(int32_t(std::floor(uv.y * texture.size.y)), 0), int32_t(texture.size.y) - 1);
+		return fetch(texture.data.data(), ty * texture.size.x + tx, cache);
+	}
+	glm::vec2 size = glm::vec2(texture.size);
+	float rho = std::max(glm::length(uv_dx * size), glm::length(uv_dy * size));
+	float lod = std::log2(rho);
+	auto level = [&texture](uint32_t l) {
+		return (l == 0 ? texture.data.data() : texture.mipmaps[l - 1].data());
+	};
+	uint32_t last = uint32_t(texture.mipmaps.size());
+	if (!(lod > 0.0f)) return sample_linear(texture.data.data(), texture.size, uv, cache);
+	if (lod >= float(last)) return sample_linear(level(last), mip_level_size(texture.size, last), uv, cache);
+	uint32_t l = uint32_t(lod);
+	glm::vec4 a = sample_linear(level(l), mip_level_size(texture.size, l), uv, cache);
+	glm::vec4 b = sample_linear(level(l + 1), mip_level_size(texture.size, l + 1), uv, cache);
+	return glm::mix(a, b, lod - float(l));
+}
+
+void SoftwareRenderer::rasterize_tile(uint32_t tile) {
+	glm::ivec2 tile_min = glm::ivec2((tile % tile_count.x) * TileSize, (tile / tile_count.x) * TileSize);
+	glm::ivec2 tile_max = glm::ivec2( //inclusive
+		std::min(tile_min.x + TileSize, size.x) - 1,
+		std::min(tile_min.y + TileSize, size.y) - 1
+	);
+
+	//clear:
+	uint32_t clear = pack_rgba8(clear_color);
+	for (int32_t y = tile_min.y; y <= tile_max.y; ++y) {
+		std::fill(&color[y * size.x + tile_min.x], &color[y * size.x + tile_max.x] + 1, clear);
+		std::fill(&depth[y * size.x + tile_min.x], &depth[y * size.x + tile_max.x] + 1, 1.0f);
+	}
+
+	TexelCache cache_storage;
+	TexelCache *cache = nullptr;
+	if (measure_texture_cache) {
+		std::fill(cache_storage.tags, cache_storage.tags + TexelCache::Lines, uintptr_t(0));
+		cache_storage.stats = &tile_texture_cache[tile];
+		*cache_storage.stats = TextureCacheStats();
+		cache = &cache_storage;
+	}
+
+	for (Triangle const *tp : tiles[tile]) {
+		Triangle const &t = *tp;
+		glm::ivec2 lo = glm::max(t.min, tile_min);
+		glm::ivec2 hi = glm::min(t.max, tile_max);
+
+		Texture const *texture = (t.texture < textures.size() && !textures[t.texture].data.empty() ? &textures[t.texture] : nullptr);
+
+		for (int32_t y = lo.y; y <= hi.y; ++y) {
+			float cy = y + 0.5f;
+			for (int32_t x = lo.x; x <= hi.x; x += 4) {
+				//evaluate edge functions and depth for four pixels at once:
+				float e[3][4];
+				float z[4];
+				uint32_t mask = 0;
+				#ifdef SOFTWARE_RENDERER_SSE
+				__m128 cx = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				__m128 vz = _mm_setzero_ps();
+				for (uint32_t k = 0; k < 3; ++k) {
+					__m128 ek = _mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(t.edge_a[k]), cx),
+						_mm_set1_ps(t.edge_b[k] * cy + t.edge_c[k])
+					);
+					inside = _mm_and_ps(inside, t.top_left[k] ? _mm_cmpge_ps(ek, _mm_setzero_ps()) : _mm_cmpgt_ps(ek, _mm_setzero_ps()));
+					vz = _mm_add_ps(vz, _mm_mul_ps(ek, _mm_set1_ps(t.depth[k] * t.inv_area)));
+					_mm_storeu_ps(e[k], ek);
+				}
+				_mm_storeu_ps(z, vz);
+				mask = uint32_t(_mm_movemask_ps(inside));
+				#else
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					float px = x + lane + 0.5f;
+					bool in = true;
+					z[lane] = 0.0f;
+					for (uint32_t k = 0; k < 3; ++k) {
+						e[k][lane] = t.edge_a[k] * px + (t.edge_b[k] * cy + t.edge_c[k]);
+						in = in && (t.top_left[k] ? e[k][lane] >= 0.0f : e[k][lane] > 0.0f);
+						z[lane] += e[k][lane] * (t.depth[k] * t.inv_area);
+					}
+					if (in) mask |= (1 << lane);
+				}
+				#endif
+				if (hi.x - x < 3) mask &= (1 << (hi.x - x + 1)) - 1; //lanes past the span
+				if (mask == 0) continue;
+
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					if (!(mask & (1 << lane))) continue;
+					uint32_t pixel = y * size.x + (x + lane);
+					if (!(z[lane] < depth[pixel])) continue; //GL_LESS
+
+					float b[3] = {
+						e[0][lane] * t.inv_area,
+						e[1][lane] * t.inv_area,
+						e[2][lane] * t.inv_area
+					};
+					float w = 1.0f / (b[0] * t.inv_w[0] + b[1] * t.inv_w[1] + b[2] * t.inv_w[2]);
+					glm::vec3 normal = (t.normal[0] * b[0] + t.normal[1] * b[1] + t.normal[2] * b[2]) * w;
+					glm::vec2 uv = (t.uvcoord[0] * b[0] + t.uvcoord[1] * b[1] + t.uvcoord[2] * b[2]) * w;
+
+					//same shading as the fragment shader in main.cpp:
+					float len = glm::length(normal);
+					float light = (len > 0.0f ? std::max(0.0f, glm::dot(normal / len, to_light)) : 0.0f);
+					glm::vec4 tex_color = glm::vec4(1.0f);
+					if (texture) {
+						//(derivatives of uv = (uv / w) / (1 / w), by the quotient rule)
+						glm::vec2 uv_dx = (t.uvcoord_dx - uv * t.inv_w_dx) * w;
+						glm::vec2 uv_dy = (t.uvcoord_dy - uv * t.inv_w_dy) * w;
+						tex_color = sample(*texture, uv, uv_dx, uv_dy, cache);
+						if (cache) ++cache->stats->pixels;
+					}
+					glm::vec4 frag = glm::vec4(glm::vec3(tex_color) * light, tex_color.w);
+
+					//blend (SRC_ALPHA, ONE_MINUS_SRC_ALPHA):
+					glm::vec4 dst = unpack_rgba8(color[pixel]);
+					color[pixel] = pack_rgba8(frag * frag.w + dst * (1.0f - frag.w));
+					depth[pixel] = z[lane];
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "Meshes.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+//"SoftwareRenderer" draws a Scene on the CPU, for machines without a GPU and for deterministic reference images.
+// It follows the same rules as the OpenGL path in main.cpp: perspective-correct attributes, Lambert lighting
+// times a clamped texture (sampled trilinearly if it has mipmaps, with the level of detail OpenGL would pick from
+// the exact screen-space derivatives of uv, and nearest otherwise), GL_LESS depth test, and
+// SRC_ALPHA/ONE_MINUS_SRC_ALPHA blending in draw order.
+// Triangles are binned into screen tiles and tiles are shaded in parallel; results do not depend on thread count.
+//
+// Vertex data comes from Meshes::cpu_vertices / cpu_indices (i.e., meshes added with Meshes::load_cpu), and
+// textures are looked up by Scene::Object::texture_used.
+
+struct SoftwareRenderer {
+	SoftwareRenderer(glm::uvec2 const &size, ThreadPool *pool = nullptr);
+
+	struct Texture {
+		glm::uvec2 size = glm::uvec2(0, 0);
+		std::vector< uint32_t > data; //RGBA8, row 0 at v = 0 (i.e., as loaded with LowerLeftOrigin)
+		std::vector< std::vector< uint32_t > > mipmaps; //levels 1 and up (see Mipmaps.hpp), or empty
+	};
+	std::vector< Texture > textures;
+
+	//texture cache measurement (off by default, since it costs a little per texel):
+	// each tile's texel fetches go through a simulated 16KB direct-mapped cache of 64-byte lines (emptied
+	// at the start of each tile, as if each tile had a core to itself), counting fetches and misses.
+	// Totals accumulate over render() calls; the counts don't depend on thread count.
+	bool measure_texture_cache = false;
+	struct TextureCacheStats {
+		uint64_t pixels = 0; //textured fragments
+		uint64_t fetches = 0; //texels read
+		uint64_t misses = 0; //cache lines read
+	};
+	TextureCacheStats texture_cache;
+
+	glm::vec4 clear_color = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+	glm::vec3 to_light = glm::vec3(0.0f, 0.0f, 1.0f); //camera-space direction to light (normalized)
+
+	void render(Scene const &scene, Meshes const &meshes);
+
+	//output (row 0 at the bottom; pass LowerLeftOrigin to save_png):
+	glm::uvec2 size;
+	std::vector< uint32_t > color; //RGBA8
+	std::vector< float > depth; //window-space depth in [0,1]
+
+	//internals:
+	static constexpr uint32_t TileSize = 32;
+	static constexpr uint32_t ObjectBatch = 64; //objects a lane takes at a time when transforming
+	ThreadPool *pool;
+
+	struct ClipVertex { //transformed vertex, before clipping
+		glm::vec4 clip;
+		glm::vec3 normal;
+		glm::vec2 uvcoord;
+	};
+	std::vector< std::vector< ClipVertex > > lane_vertices; //per lane of the transform loop, sized to the largest mesh
+
+	struct Triangle { //screen-space triangle, ready to rasterize
+		glm::vec2 position[3]; //window coordinates (pixel centers at +0.5)
+		float depth[3]; //window-space depth
+		float inv_w[3]; //1 / clip w, for perspective correction
+		glm::vec3 normal[3]; //camera-space normal / w
+		glm::vec2 uvcoord[3]; //uv / w
+		glm::ivec2 min, max; //inclusive pixel bounds, clamped to the output
+		float edge_a[3], edge_b[3], edge_c[3]; //edge functions a*x + b*y + c (edge k is opposite vertex k; positive inside)
+		bool top_left[3]; //does edge k own pixels exactly on it?
+		float inv_area; //1 / (sum of edge functions), to turn edge functions into barycentric weights
+		glm::vec2 uvcoord_dx, uvcoord_dy; //screen-space derivatives of uv / w (constant over the triangle)
+		float inv_w_dx, inv_w_dy; //and of 1 / w, for uv's derivatives (and the level of detail)
+		uint32_t texture;
+	};
+	std::vector< std::vector< Triangle > > object_triangles; //per object, in draw order
+	std::vector< std::vector< Triangle const * > > tiles; //per tile, in draw order
+	glm::uvec2 tile_count;
+	std::vector< TextureCacheStats > tile_texture_cache; //per tile, summed into texture_cache after each render()
+
+	void rasterize_tile(uint32_t tile);
+};
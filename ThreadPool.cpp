@@ -0,0 +1,101 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t count) {
+	if (count == 0) {
+		count = std::thread::hardware_concurrency();
+		if (count == 0) count = 1;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		threads.emplace_back(&ThreadPool::worker, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	job_cv.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::run(std::function< void() > const &job) {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(job);
+	}
+	job_cv.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock< std::mutex > lock(mutex);
+	done_cv.wait(lock, [this](){ return jobs.empty() && running == 0; });
+}
+
+void ThreadPool::worker() {
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		job_cv.wait(lock, [this](){ return quit || !jobs.empty(); });
+		if (jobs.empty()) break; //(quit is set and nothing is left to do)
+		std::function< void() > job = std::move(jobs.front());
+		jobs.pop_front();
+		++running;
+		lock.unlock();
+		job();
+		lock.lock();
+		--running;
+		done_cv.notify_all();
+	}
+}
+
+void ThreadPool::parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn) {
+	if (count == 0) return;
+
+	//shared state lives on the heap because helpers may start after this call returns
+	// (e.g., if the workers are busy with other jobs); such late helpers find no work left:
+	struct State {
+		uint32_t total_count = 0;
+		std::function< void(uint32_t) > fn;
+		std::atomic< uint32_t > next;
+		std::atomic< uint32_t > finished;
+		std::mutex mutex;
+		std::condition_variable cv;
+		void work() {
+			uint32_t count_done = 0;
+			uint32_t total = total_count;
+			for (uint32_t i = next++; i < total; i = next++) {
+				fn(i);
+				++count_done;
+			}
+			if (count_done && (finished += count_done) == total) {
+				std::unique_lock< std::mutex > lock(mutex);
+				cv.notify_all();
+			}
+		}
+	};
+	std::shared_ptr< State > state = std::make_shared< State >();
+	state->fn = fn;
+	state->next = 0;
+	state->finished = 0;
+	state->total_count = count;
+
+	uint32_t helpers = std::min< uint32_t >(size(), count - 1);
+	for (uint32_t i = 0; i < helpers; ++i) {
+		run([state](){ state->work(); });
+	}
+	state->work();
+
+	std::unique_lock< std::mutex > lock(state->mutex);
+	state->cv.wait(lock, [&state](){ return state->finished == state->total_count; });
+}
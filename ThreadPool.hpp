@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+//"ThreadPool" runs jobs on a fixed set of worker threads.
+
+struct ThreadPool {
+	//make a pool with 'count' workers (0 means one per hardware thread):
+	ThreadPool(uint32_t count = 0);
+	~ThreadPool(); //note: finishes all queued jobs before returning
+	ThreadPool(ThreadPool const &) = delete;
+
+	//queue 'job' to run on some worker:
+	void run(std::function< void() > const &job);
+
+	//wait until every queued job has finished:
+	void wait();
+
+	//call 'fn(i)' for every i in [0,count), spread over the workers and the calling thread;
+	// returns once every call has finished:
+	void parallel_for(uint32_t count, std::function< void(uint32_t) > const &fn);
+
+	uint32_t size() const { return uint32_t(threads.size()); }
+
+	//pool for loading code to share (block decompression, checksums), made on first use:
+	// note: parallel_for() on it is safe from any thread, since the caller works too.
+	static ThreadPool &shared();
+
+	//internals:
+	std::vector< std::thread > threads;
+	std::deque< std::function< void() > > jobs;
+	uint32_t running = 0; //jobs currently executing
+	bool quit = false;
+	std::mutex mutex;
+	std::condition_variable job_cv; //signalled when jobs are added (or on quit)
+	std::condition_variable done_cv; //signalled when a job finishes
+	void worker();
+};
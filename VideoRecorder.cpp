@@ -0,0 +1,203 @@
+#include "VideoRecorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define VIDEO_RECORDER_SSE 1
+#include <emmintrin.h>
+#endif
+
+VideoRecorder::VideoRecorder(glm::uvec2 const &size_, std::string const &filename, uint32_t fps, uint32_t buffers) : size(size_), readback(size_), file(filename, std::ios::binary) {
+	if (!file) {
+		throw std::runtime_error("Failed to open '" + filename + "' for recording.");
+	}
+	//'C420jpeg' is plain 4:2:0 with chroma centered between luma samples (what the box filter below produces):
+	file << "YUV4MPEG2 W" << size.x << " H" << size.y << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+
+	frames.resize(buffers);
+	for (uint32_t i = 0; i < buffers; ++i) {
+		frames[i].resize(size.x * size.y);
+		free_frames.emplace_back(i);
+	}
+	writer = std::thread(&VideoRecorder::write_frames, this);
+}
+
+VideoRecorder::~VideoRecorder() {
+	readback.flush([this](uint64_t, uint32_t const *pixels){ enqueue(pixels); });
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	writer.join();
+	std::cout << "VideoRecorder: wrote " << written() << " frames, dropped " << dropped() << "; "
+		<< (main_thread_calls ? main_thread_ms / main_thread_calls : 0.0) << " ms per frame on the main thread." << std::endl;
+}
+
+uint32_t VideoRecorder::written() const {
+	std::unique_lock< std::mutex > lock(mutex);
+	return written_count;
+}
+
+uint32_t VideoRecorder::dropped() const {
+	std::unique_lock< std::mutex > lock(mutex);
+	return pool_dropped + readback.dropped;
+}
+
+void VideoRecorder::record(uint64_t frame) {
+	auto before = std::chrono::high_resolution_clock::now();
+	readback.read(frame);
+	auto after = std::chrono::high_resolution_clock::now();
+	main_thread_ms += std::chrono::duration< double, std::milli >(after - before).count();
+}
+
+void VideoRecorder::update() {
+	auto before = std::chrono::high_resolution_clock::now();
+	readback.poll([this](uint64_t, uint32_t const *pixels){ enqueue(pixels); });
+	auto after = std::chrono::high_resolution_clock::now();
+	main_thread_ms += std::chrono::duration< double, std::milli >(after - before).count();
+	++main_thread_calls;
+}
+
+void VideoRecorder::enqueue(uint32_t const *pixels) {
+	uint32_t index;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		if (free_frames.empty()) {
+			++pool_dropped;
+			return;
+		}
+		index = free_frames.back();
+		free_frames.pop_back();
+	}
+	std::memcpy(frames[index].data(), pixels, size.x * size.y * 4);
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		queued_frames.emplace_back(index);
+	}
+	cv.notify_one();
+}
+
+void VideoRecorder::write_frames() {
+	glm::uvec2 chroma_size = (size + glm::uvec2(1)) / 2u;
+	std::vector< uint8_t > yuv(size.x * size.y + 2 * chroma_size.x * chroma_size.y);
+	uint8_t *y = yuv.data();
+	uint8_t *u = y + size.x * size.y;
+	uint8_t *v = u + chroma_size.x * chroma_size.y;
+
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		cv.wait(lock, [this](){ return quit || !queued_frames.empty(); });
+		if (queued_frames.empty()) break; //(quit is set and nothing is left to write)
+		uint32_t index = queued_frames.front();
+		queued_frames.pop_front();
+		lock.unlock();
+
+		rgba_to_yuv420(size, frames[index].data(), y, u, v);
+		file << "FRAME\n";
+		file.write(reinterpret_cast< char const * >(yuv.data()), yuv.size());
+
+		lock.lock();
+		free_frames.emplace_back(index);
+		++written_count;
+	}
+}
+
+//BT.601 limited range, 8 bits of fraction:
+static inline uint8_t luma(uint32_t p) {
+	int32_t r = p & 0xff, g = (p >> 8) & 0xff, b = (p >> 16) & 0xff;
+	return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+static inline uint8_t chroma_u(int32_t r, int32_t g, int32_t b) {
+	return uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+static inline uint8_t chroma_v(int32_t r, int32_t g, int32_t b) {
+	return uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+//per-channel (a + b + 1) / 2, as _mm_avg_epu8:
+static inline uint32_t average(uint32_t a, uint32_t b) {
+	return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+#ifdef VIDEO_RECORDER_SSE
+//dot each of four RGBA8 pixels with (c.r, c.g, c.b), add 128, shift, add 'offset' -> four int32s:
+static inline __m128i weigh4(__m128i rgba, __m128i coeff, __m128i offset) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_madd_epi16(_mm_unpacklo_epi8(rgba, zero), coeff); //(r*cr + g*cg, b*cb) for pixels 0, 1
+	__m128i b = _mm_madd_epi16(_mm_unpackhi_epi8(rgba, zero), coeff); //... for pixels 2, 3
+	__m128i rg = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i bb = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+	__m128i sum = _mm_add_epi32(_mm_add_epi32(rg, bb), _mm_set1_epi32(128));
+	return _mm_add_epi32(_mm_srai_epi32(sum, 8), offset);
+}
+//average 2x2 blocks of eight pixels (four from each row) -> four RGBA8 pixels:
+static inline __m128i box4(__m128i const *row0, __m128i const *row1) {
+	__m128i a = _mm_avg_epu8(_mm_loadu_si128(row0), _mm_loadu_si128(row1));
+	__m128i b = _mm_avg_epu8(_mm_loadu_si128(row0 + 1), _mm_loadu_si128(row1 + 1));
+	__m128i ha = _mm_avg_epu8(_mm_shuffle_epi32(a, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 3, 1)));
+	__m128i hb = _mm_avg_epu8(_mm_shuffle_epi32(b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_unpacklo_epi64(ha, hb);
+}
+#endif
+
+void VideoRecorder::rgba_to_yuv420(glm::uvec2 const &size, uint32_t const *rgba, uint8_t *y_plane, uint8_t *u_plane, uint8_t *v_plane) {
+	uint32_t chroma_width = (size.x + 1) / 2;
+	for (uint32_t oy = 0; oy < size.y; oy += 2) {
+		//output is top-down, input is bottom-up:
+		uint32_t const *row0 = rgba + (size.y - 1 - oy) * size.x;
+		uint32_t const *row1 = (oy + 1 < size.y ? row0 - size.x : row0);
+		uint8_t *y0 = y_plane + oy * size.x;
+		uint8_t *y1 = (oy + 1 < size.y ? y0 + size.x : nullptr);
+		uint8_t *u = u_plane + (oy / 2) * chroma_width;
+		uint8_t *v = v_plane + (oy / 2) * chroma_width;
+
+		uint32_t x = 0;
+		#ifdef VIDEO_RECORDER_SSE
+		__m128i y_coeff = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+		__m128i u_coeff = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+		__m128i v_coeff = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+		__m128i y_offset = _mm_set1_epi32(16);
+		__m128i uv_offset = _mm_set1_epi32(128);
+		for (; x + 16 <= size.x; x += 16) {
+			for (uint32_t r = 0; r < 2; ++r) {
+				uint8_t *out = (r == 0 ? y0 : y1);
+				if (!out) continue;
+				__m128i const *in = reinterpret_cast< __m128i const * >((r == 0 ? row0 : row1) + x);
+				__m128i l0 = _mm_packs_epi32(weigh4(_mm_loadu_si128(in + 0), y_coeff, y_offset), weigh4(_mm_loadu_si128(in + 1), y_coeff, y_offset));
+				__m128i l1 = _mm_packs_epi32(weigh4(_mm_loadu_si128(in + 2), y_coeff, y_offset), weigh4(_mm_loadu_si128(in + 3), y_coeff, y_offset));
+				_mm_storeu_si128(reinterpret_cast< __m128i * >(out + x), _mm_packus_epi16(l0, l1));
+			}
+			for (uint32_t c = 0; c < 16; c += 8) {
+				__m128i box = box4(reinterpret_cast< __m128i const * >(row0 + x + c), reinterpret_cast< __m128i const * >(row1 + x + c));
+				__m128i us = _mm_packs_epi32(weigh4(box, u_coeff, uv_offset), _mm_setzero_si128());
+				__m128i vs = _mm_packs_epi32(weigh4(box, v_coeff, uv_offset), _mm_setzero_si128());
+				int32_t u4 = _mm_cvtsi128_si32(_mm_packus_epi16(us, us));
+				int32_t v4 = _mm_cvtsi128_si32(_mm_packus_epi16(vs, vs));
+				std::memcpy(u + (x + c) / 2, &u4, 4);
+				std::memcpy(v + (x + c) / 2, &v4, 4);
+			}
+		}
+		#endif
+		//remaining columns (and everything, without SSE2):
+		for (; x < size.x; x += 2) {
+			uint32_t x1 = std::min(x + 1, size.x - 1);
+			y0[x] = luma(row0[x]);
+			if (x1 != x) y0[x1] = luma(row0[x1]);
+			if (y1) {
+				y1[x] = luma(row1[x]);
+				if (x1 != x) y1[x1] = luma(row1[x1]);
+			}
+			//(rounds like the SSE2 path: average vertically, then horizontally)
+			uint32_t left = average(row0[x], row1[x]);
+			uint32_t right = average(row0[x1], row1[x1]);
+			uint32_t box = average(left, right);
+			int32_t r = box & 0xff, g = (box >> 8) & 0xff, b = (box >> 16) & 0xff;
+			u[x / 2] = chroma_u(r, g, b);
+			v[x / 2] = chroma_v(r, g, b);
+		}
+	}
+}
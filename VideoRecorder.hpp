@@ -0,0 +1,55 @@
+#pragma once
+
+#include "AsyncReadback.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//"VideoRecorder" streams every frame to an uncompressed Y4M (YUV4MPEG2, 4:2:0) file:
+// frames are read back with AsyncReadback, then converted RGBA -> YUV 4:2:0 (with SSE2 where available)
+// and written by a worker thread. Memory use is bounded by a fixed pool of frame buffers; if no buffer
+// is free (i.e., the disk can't keep up), the frame is dropped and counted rather than stalling the game.
+
+struct VideoRecorder {
+	//note: will throw if the file can't be opened.
+	VideoRecorder(glm::uvec2 const &size, std::string const &filename, uint32_t fps = 60, uint32_t buffers = 4);
+	~VideoRecorder(); //note: waits for in-flight frames to be written
+
+	//record the frame that was just drawn (call before swapping buffers):
+	void record(uint64_t frame);
+
+	//call once per frame to hand finished readbacks to the writer:
+	void update();
+
+	uint32_t written() const;
+	uint32_t dropped() const;
+	//time spent on the frame loop's thread in record() + update():
+	double main_thread_ms = 0.0;
+	uint32_t main_thread_calls = 0;
+
+	//convert a bottom-up RGBA8 frame to top-down planar YUV 4:2:0 (BT.601, limited range):
+	// (y is size.x * size.y bytes; u and v are ((size.x+1)/2) * ((size.y+1)/2) bytes each)
+	static void rgba_to_yuv420(glm::uvec2 const &size, uint32_t const *rgba, uint8_t *y, uint8_t *u, uint8_t *v);
+
+	//internals:
+	glm::uvec2 size;
+	AsyncReadback readback;
+	std::ofstream file;
+
+	std::vector< std::vector< uint32_t > > frames; //buffer pool
+	std::vector< uint32_t > free_frames; //indices of unused buffers
+	std::deque< uint32_t > queued_frames; //indices of buffers waiting to be written
+	uint32_t written_count = 0;
+	uint32_t pool_dropped = 0;
+	bool quit = false;
+	mutable std::mutex mutex;
+	std::condition_variable cv;
+	std::thread writer;
+	void write_frames();
+	void enqueue(uint32_t const *pixels);
+};
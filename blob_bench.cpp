@@ -0,0 +1,440 @@
+#include "Meshes.hpp"
+#include "AssetPackage.hpp"
+#include "BlobWriter.hpp"
+#include "MappedBlob.hpp"
+#include "Mipmaps.hpp"
+#include "SceneLoader.hpp"
+#include "ThreadPool.hpp"
+#include "load_save_png.hpp"
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//"blob_bench" measures how fast the blob parsers run on synthetic files of 1 to --max entries
+// (every power of ten), reporting the best of --repeat runs in MB/s and entries/s:
+// - read_chunk: one 'scn0' chunk through read_chunk() from a stream, into a vector and into caller memory;
+// - meshes: Meshes::File::read() (chunk lookup, name and range checks, index validation) on an exported
+//   file ('v3n3' / 'str0' / 'idx0'; one triangle per mesh) and on a cooked one (versioned, 'qv16' /
+//   'ix32' / 'idx1' / 'box0' / 'bnd0'; chunk checksums included unless --trusted);
+// - scene: AssetPackage::read_scene() (names and transforms, as hot reload reads scene.blob) on 'str0' / 'scn0',
+//   and load_scene() (see SceneLoader.hpp), which makes Scene objects from it in bulk.
+//Files are built and parsed in memory (see MappedBlob's memory constructor), so disk speed doesn't count.
+//
+//Given PNG files instead, it times decoding all of them as the game's loaders do (each image a separate
+// job on a ThreadPool) with 1, 2, 4, ... up to --threads workers (default: one per hardware thread),
+// again from memory; 'bytes' is then the size of the PNG files. Then it times building their mipmap chains
+// (see Mipmaps.hpp) with the scalar and SSE code on one thread, and with SSE on --threads workers
+// ('bytes' is then the size of the decoded level 0s), checking that the two give the same texels.
+//Makes no OpenGL calls.
+//
+//Built with -DBLOB_FUZZER, this file instead provides a libFuzzer entry point that runs the same
+// parsers on arbitrary bytes (they should throw on bad input, never crash or hang). Checksums are off
+// there (chunk CRCs through MappedBlob::verify_checksums, the table of contents' CRC in MappedBlob.cpp),
+// since mutated bytes would almost never get past them. E.g. (the files are BENCH_NAMES in the Jamfile):
+//	clang++ -std=c++11 -g -O1 -fsanitize=fuzzer,address -DBLOB_FUZZER -o blob_fuzz blob_bench.cpp Meshes.cpp
+//		MeshOptimizer.cpp MappedBlob.cpp BlobWriter.cpp Checksum.cpp NameTable.cpp GeometryArena.cpp Compression.cpp
+//		ThreadPool.cpp AssetPackage.cpp Mipmaps.cpp load_save_png.cpp Scene.cpp SceneLoader.cpp RenderCommands.cpp
+//		-lpng -lz -lGL
+//	./blob_fuzz -close_fd_mask=2 corpus/ dist/meshes.blob dist/scene.blob
+
+#ifndef BLOB_FUZZER
+
+static std::string mesh_name(uint32_t i) {
+	char name[16];
+	std::snprintf(name, sizeof(name), "mesh%07u", i);
+	return name;
+}
+
+//exported mesh file: 'count' one-triangle meshes, in write_chunk()'s format:
+static std::string make_exported_meshes(uint32_t count) {
+	struct IndexEntry0 {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_start, vertex_count;
+	};
+	std::vector< Meshes::Vertex > vertices;
+	std::vector< char > strings;
+	std::vector< IndexEntry0 > index;
+	vertices.reserve(count * 3);
+	index.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		IndexEntry0 entry;
+		entry.vertex_start = uint32_t(vertices.size());
+		entry.vertex_count = 3;
+		glm::vec3 at = glm::vec3(float(i % 1000), float(i / 1000), 0.0f);
+		for (uint32_t v = 0; v < 3; ++v) {
+			Meshes::Vertex vertex;
+			vertex.Position = at + glm::vec3(float(v == 1), float(v == 2), 0.0f);
+			vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertex.UVCoord = glm::vec2(float(v == 1), float(v == 2));
+			vertices.emplace_back(vertex);
+		}
+		std::string name = mesh_name(i);
+		entry.name_begin = uint32_t(strings.size());
+		strings.insert(strings.end(), name.begin(), name.end());
+		entry.name_end = uint32_t(strings.size());
+		index.emplace_back(entry);
+	}
+	std::ostringstream out;
+	write_chunk(out, "v3n3", vertices);
+	write_chunk(out, "str0", strings);
+	write_chunk(out, "idx0", index);
+	return out.str();
+}
+
+//cooked mesh file: the same meshes, already quantized, indexed, and bounded:
+static std::string make_cooked_meshes(uint32_t count) {
+	struct IndexEntry1 {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_start, vertex_count;
+		uint32_t index_start, index_count;
+	};
+	std::vector< Meshes::PackedVertex > vertices;
+	std::vector< uint32_t > indices;
+	std::vector< char > strings;
+	std::vector< IndexEntry1 > index;
+	std::vector< Meshes::Box > boxes;
+	std::vector< Meshes::Bounds > bounds;
+	vertices.reserve(count * 3);
+	indices.reserve(count * 3);
+	index.reserve(count);
+	boxes.reserve(count);
+	bounds.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		Meshes::Box box;
+		box.min = glm::vec3(float(i % 1000), float(i / 1000), 0.0f);
+		box.size = glm::vec3(1.0f);
+		IndexEntry1 entry;
+		entry.vertex_start = uint32_t(vertices.size());
+		entry.vertex_count = 3;
+		entry.index_start = uint32_t(indices.size());
+		entry.index_count = 3;
+		for (uint32_t v = 0; v < 3; ++v) {
+			Meshes::Vertex vertex;
+			vertex.Position = box.min + glm::vec3(float(v == 1), float(v == 2), 0.0f);
+			vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertex.UVCoord = glm::vec2(float(v == 1), float(v == 2));
+			vertices.emplace_back(Meshes::pack(vertex, box));
+			indices.emplace_back(v);
+		}
+		std::string name = mesh_name(i);
+		entry.name_begin = uint32_t(strings.size());
+		strings.insert(strings.end(), name.begin(), name.end());
+		entry.name_end = uint32_t(strings.size());
+		index.emplace_back(entry);
+		boxes.emplace_back(box);
+		Meshes::Bounds b;
+		b.min = box.min;
+		b.max = box.min + glm::vec3(1.0f, 1.0f, 0.0f);
+		b.sphere_center = 0.5f * (b.min + b.max);
+		b.sphere_radius = 0.5f * glm::length(b.max - b.min);
+		bounds.emplace_back(b);
+	}
+	BlobWriter writer;
+	writer.add_chunk("str0", strings);
+	writer.add_chunk("idx1", index);
+	writer.add_chunk("box0", boxes);
+	writer.add_chunk("bnd0", bounds);
+	writer.add_chunk("qv16", vertices, 64);
+	writer.add_chunk("ix32", indices, 64);
+	std::ostringstream out;
+	writer.write(out);
+	return out.str();
+}
+
+static std::vector< AssetPackage::SceneEntry > make_scene_entries(uint32_t count, std::vector< char > *strings) {
+	std::vector< AssetPackage::SceneEntry > entries;
+	entries.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		AssetPackage::SceneEntry entry;
+		std::string name = mesh_name(i);
+		entry.name_begin = uint32_t(strings->size());
+		strings->insert(strings->end(), name.begin(), name.end());
+		entry.name_end = uint32_t(strings->size());
+		entry.position = glm::vec3(float(i % 1000), float(i / 1000), 0.0f);
+		entry.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		entry.scale = glm::vec3(1.0f);
+		entry.dimension = glm::vec3(1.0f);
+		entries.emplace_back(entry);
+	}
+	return entries;
+}
+
+//scene file: 'count' objects, in scene.blob's format:
+static std::string make_scene(uint32_t count) {
+	std::vector< char > strings;
+	std::vector< AssetPackage::SceneEntry > entries = make_scene_entries(count, &strings);
+	std::ostringstream out;
+	write_chunk(out, "str0", strings);
+	write_chunk(out, "scn0", entries);
+	return out.str();
+}
+
+//best time of 'repeats' runs of 'run', in milliseconds:
+template< typename F >
+static double best_ms(uint32_t repeats, F const &run) {
+	double best = 0.0;
+	for (uint32_t r = 0; r < repeats; ++r) {
+		auto before = std::chrono::high_resolution_clock::now();
+		run();
+		double ms = std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - before).count();
+		if (r == 0 || ms < best) best = ms;
+	}
+	return best;
+}
+
+static void report(std::string const &parser, uint32_t entries, size_t bytes, double ms) {
+	double seconds = std::max(ms, 1e-6) / 1000.0;
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-22s %9u %12zu %10.3f %10.1f %14.0f", parser.c_str(), entries, bytes, ms, bytes / seconds / 1e6, entries / seconds);
+	std::cout << line << std::endl;
+}
+
+//decode every PNG in 'files' (already read into memory) on a pool of 'threads' workers:
+static void bench_pngs(std::vector< std::string > const &files, uint32_t threads, uint32_t repeats) {
+	size_t bytes = 0;
+	for (auto const &file : files) {
+		bytes += file.size();
+	}
+	ThreadPool pool(threads);
+	std::vector< std::vector< uint32_t > > pixels(files.size());
+	std::atomic< uint32_t > failed(0);
+	report("png decode (" + std::to_string(threads) + " thr)", uint32_t(files.size()), bytes, best_ms(repeats, [&](){
+		for (uint32_t i = 0; i < files.size(); ++i) {
+			pool.run([&, i](){
+				std::istringstream in(files[i]);
+				if (!load_png(in, nullptr, nullptr, &pixels[i], LowerLeftOrigin)) ++failed;
+			});
+		}
+		pool.wait();
+	}));
+	if (failed) throw std::runtime_error(std::to_string(failed / repeats) + " PNGs failed to decode");
+}
+
+//build mipmap chains for every PNG in 'files' (decoded first, untimed):
+static void bench_mipmaps(std::vector< std::string > const &files, uint32_t threads, uint32_t repeats) {
+	std::vector< glm::uvec2 > sizes(files.size());
+	std::vector< std::vector< uint32_t > > pixels(files.size());
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < files.size(); ++i) {
+		std::istringstream in(files[i]);
+		if (!load_png(in, &sizes[i].x, &sizes[i].y, &pixels[i], LowerLeftOrigin)) throw std::runtime_error("a PNG failed to decode");
+		bytes += pixels[i].size() * sizeof(uint32_t);
+	}
+	std::vector< std::vector< std::vector< uint32_t > > > scalar(files.size()), sse(files.size());
+	report("mipmaps (scalar)", uint32_t(files.size()), bytes, best_ms(repeats, [&](){
+		for (uint32_t i = 0; i < files.size(); ++i) {
+			scalar[i] = make_mipmaps_scalar(sizes[i], pixels[i].data());
+		}
+	}));
+	report("mipmaps (SSE)", uint32_t(files.size()), bytes, best_ms(repeats, [&](){
+		for (uint32_t i = 0; i < files.size(); ++i) {
+			sse[i] = make_mipmaps(sizes[i], pixels[i].data());
+		}
+	}));
+	ThreadPool pool(threads);
+	report("mipmaps (SSE, " + std::to_string(threads) + " thr)", uint32_t(files.size()), bytes, best_ms(repeats, [&](){
+		pool.parallel_for(uint32_t(files.size()), [&](uint32_t i){
+			sse[i] = make_mipmaps(sizes[i], pixels[i].data());
+		});
+	}));
+	if (scalar != sse) throw std::runtime_error("scalar and SSE mipmaps differ");
+}
+
+int main(int argc, char **argv) {
+	uint32_t max = 1000000;
+	uint32_t repeats = 5;
+	uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+	std::vector< std::string > pngs;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--max" && argi + 1 < argc) {
+			max = uint32_t(std::max(1L, std::atol(argv[++argi])));
+		} else if (arg == "--repeat" && argi + 1 < argc) {
+			repeats = uint32_t(std::max(1L, std::atol(argv[++argi])));
+		} else if (arg == "--trusted") {
+			MappedBlob::verify_checksums = false;
+		} else if (arg == "--threads" && argi + 1 < argc) {
+			threads = uint32_t(std::max(1L, std::atol(argv[++argi])));
+		} else if (arg.size() > 4 && arg.substr(arg.size() - 4) == ".png") {
+			pngs.emplace_back(arg);
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--max <entries>] [--repeat <runs>] [--trusted]\n"
+				"\t" << argv[0] << " [--repeat <runs>] [--threads <count>] <file.png> [...]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (!pngs.empty()) {
+		try {
+			std::vector< std::string > files;
+			for (auto const &png : pngs) {
+				std::ifstream in(png, std::ios::binary);
+				std::ostringstream data;
+				if (!(data << in.rdbuf())) throw std::runtime_error("Failed to read '" + png + "'.");
+				files.emplace_back(data.str());
+			}
+			std::cout << "parser                    images        bytes         ms       MB/s       images/s" << std::endl;
+			for (uint32_t t = 1; t < threads; t *= 2) {
+				bench_pngs(files, t, repeats);
+			}
+			bench_pngs(files, threads, repeats);
+			bench_mipmaps(files, threads, repeats);
+		} catch (std::exception &e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	try {
+		std::cout << "parser                   entries        bytes         ms       MB/s      entries/s" << std::endl;
+		for (uint64_t count = 1; count <= max; count *= 10) {
+			uint32_t n = uint32_t(count);
+
+			{ //read_chunk, from a stream:
+				std::vector< char > strings;
+				std::vector< AssetPackage::SceneEntry > entries = make_scene_entries(n, &strings);
+				std::ostringstream out;
+				write_chunk(out, "scn0", entries);
+				std::istringstream in(out.str());
+				size_t bytes = out.str().size();
+
+				report("read_chunk (vector)", n, bytes, best_ms(repeats, [&](){
+					in.seekg(0);
+					std::vector< AssetPackage::SceneEntry > to;
+					read_chunk(in, "scn0", &to);
+				}));
+				std::unique_ptr< char[] > storage(new char[entries.size() * sizeof(AssetPackage::SceneEntry)]); //(uninitialized)
+				AssetPackage::SceneEntry *into = reinterpret_cast< AssetPackage::SceneEntry * >(storage.get());
+				report("read_chunk (caller)", n, bytes, best_ms(repeats, [&](){
+					in.seekg(0);
+					if (read_chunk(in, "scn0", into, entries.size()) != entries.size()) {
+						throw std::runtime_error("read_chunk read the wrong number of entries");
+					}
+				}));
+			}
+
+			//Meshes::File::read:
+			auto bench_meshes = [&](std::string const &parser, std::string const &data) {
+				report(parser, n, data.size(), best_ms(repeats, [&](){
+					Meshes::File file;
+					file.read(std::make_shared< MappedBlob >(parser, data.data(), data.size()));
+					file.blob->wait_verified();
+					if (file.entries.size() != n) throw std::runtime_error(parser + " read the wrong number of meshes");
+				}));
+			};
+			bench_meshes("meshes (exported)", make_exported_meshes(n));
+			bench_meshes("meshes (cooked)", make_cooked_meshes(n));
+
+			{ //AssetPackage::read_scene:
+				std::string data = make_scene(n);
+				report("scene", n, data.size(), best_ms(repeats, [&](){
+					MappedBlob blob("scene", data.data(), data.size());
+					std::vector< AssetPackage::Object > objects;
+					AssetPackage::read_scene(blob, "str0", &objects);
+					if (objects.size() != n) throw std::runtime_error("read_scene read the wrong number of objects");
+				}));
+				NameTable names; //(names are interned by the first run, as the game's material table interns them before the scene loads)
+				report("scene (instantiate)", n, data.size(), best_ms(repeats, [&](){
+					MappedBlob blob("scene", data.data(), data.size());
+					Scene scene;
+					load_scene(blob, "str0", &names, [](uint32_t){ return true; }, &scene);
+					if (scene.objects.size() != n) throw std::runtime_error("load_scene made the wrong number of objects");
+				}));
+			}
+		}
+	} catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+#else //BLOB_FUZZER
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***) {
+	MappedBlob::verify_checksums = false;
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+	char const *bytes = reinterpret_cast< char const * >(data);
+
+	{ //unversioned chunks, through read_chunk() (each read with the magic its header claims):
+		std::istringstream in(std::string(bytes, size));
+		std::vector< char > chunk;
+		try {
+			while (in.peek() != std::istringstream::traits_type::eof()) {
+				char magic[4] = {'\0', '\0', '\0', '\0'};
+				std::streampos at = in.tellg();
+				in.read(magic, 4);
+				in.clear();
+				in.seekg(at);
+				read_chunk(in, std::string(magic, 4), &chunk);
+			}
+		} catch (std::exception &) {
+		}
+	}
+
+	std::shared_ptr< MappedBlob > blob;
+	try {
+		blob = std::make_shared< MappedBlob >("fuzz", bytes, size);
+	} catch (std::exception &) {
+		return 0;
+	}
+
+	//every chunk by itself (including decompression):
+	for (auto const &chunk : blob->chunks) {
+		try {
+			blob->find_chunk< char >(std::string(chunk.entry.magic, 4));
+		} catch (std::exception &) {
+		}
+	}
+	try {
+		blob->wait_verified();
+	} catch (std::exception &) {
+	}
+
+	//mesh index:
+	try {
+		Meshes::File file;
+		file.read(std::make_shared< MappedBlob >("fuzz", bytes, size));
+		file.blob->wait_verified();
+	} catch (std::exception &) {
+	}
+
+	//scene (as scene.blob and as in a package):
+	for (std::string strings : {"str0", "pst0"}) {
+		try {
+			MappedBlob scene("fuzz", bytes, size);
+			std::vector< AssetPackage::Object > objects;
+			AssetPackage::read_scene(scene, strings, &objects);
+		} catch (std::exception &) {
+		}
+		try {
+			MappedBlob file("fuzz", bytes, size);
+			NameTable names;
+			Scene scene;
+			load_scene(file, strings, &names, [](uint32_t id){ return id % 2 == 0; }, &scene);
+		} catch (std::exception &) {
+		}
+	}
+	return 0;
+}
+
+#endif //BLOB_FUZZER
@@ -0,0 +1,68 @@
+#include "Meshes.hpp"
+#include "AssetPackage.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//"cook" converts exported mesh files into the format the game loads fastest:
+// quantized, welded, and optimized (see MeshOptimizer.hpp), with precomputed bounds, so load() only
+// has to upload them.
+//With --package, it instead reads a whole asset directory (meshes.blob, scene.blob, and the PNGs)
+// and writes the AssetPackage the game maps at startup (see AssetPackage.hpp).
+//Makes no OpenGL calls.
+
+int main(int argc, char **argv) {
+	bool optimize = true;
+	bool compress = false;
+	bool package = false;
+	std::string in, out;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--no-optimize") {
+			optimize = false;
+		} else if (arg == "--compress") {
+			compress = true;
+		} else if (arg == "--package") {
+			package = true;
+		} else if (in == "") {
+			in = arg;
+		} else if (out == "") {
+			out = arg;
+		} else {
+			in = "";
+			break;
+		}
+	}
+	if (in == "" || out == "") {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--no-optimize] [--compress] <in.blob> <out.blob>\n"
+			"\t" << argv[0] << " --package [--no-optimize] [--compress] <asset dir> <out.blob>" << std::endl;
+		return 1;
+	}
+
+	try {
+		if (package) {
+			AssetPackage::cook(in, out, optimize, compress);
+			return 0;
+		}
+		Meshes::File file;
+		file.read(in);
+		if (!file.indices.empty()) {
+			std::cerr << "WARNING: '" << in << "' is already cooked; writing it unchanged." << std::endl;
+		}
+		file.quantize();
+		if (file.indices.empty()) {
+			file.weld();
+			if (optimize) file.optimize();
+		}
+		if (!file.has_bounds) file.compute_bounds();
+		file.blob->wait_verified();
+		file.write(out, compress);
+		std::cout << "Cooked " << file.entries.size() << " meshes from '" << in << "' into '" << out << "'." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
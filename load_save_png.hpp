@@ -6,6 +6,7 @@
 
 /*
  * Load and save PNG files.
+ * (libpng state is per call, so several images can be decoded at once on different threads.)
  */
 
 enum OriginLocation {
@@ -2,35 +2,42 @@
 #include "GL.hpp"
 #include "Meshes.hpp"
 #include "Scene.hpp"
-#include "read_chunk.hpp"
+#include "MappedBlob.hpp"
+#include "Headless.hpp"
+#include "FrameTimer.hpp"
+#include "CameraPath.hpp"
+#include "ThreadPool.hpp"
+#include "SoftwareRenderer.hpp"
+#include "FrameCapture.hpp"
+#include "VideoRecorder.hpp"
+#include "DynamicResolution.hpp"
+#include "AssetStreamer.hpp"
+#include "NameTable.hpp"
+#include "SceneLoader.hpp"
+#include "AssetPackage.hpp"
+#include "FileWatcher.hpp"
+#include "Mipmaps.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
+#include <memory>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 static GLuint compile_shader(GLenum type, std::string const &source);
 static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
-
-static const int NUM_PNG = 10;
-
-static const std::string PNG_LIST[NUM_PNG] = {
-	"balloon1.png",
-	"balloon2.png",
-	"balloon3.png",
-	"stand.png",
-	"base.png",
-	"link1.png",
-	"link2.png",
-	"link3.png",
-	"crate.png",
-	"cube.png",
-};
+static long peak_rss_kb(); //(0 where not available)
 
 static const std::string B1 = std::string("Balloon1");
 static const std::string B2 = std::string("Balloon2");
@@ -46,62 +53,213 @@ int main(int argc, char **argv) {
 	struct {
 		std::string title = "Game2: Scene";
 		glm::uvec2 size = glm::uvec2(640, 480);
+		//headless mode renders offscreen (no window, no vsync) for a fixed number of frames, then exits:
+		bool headless = false;
+		uint32_t frames = 0;
+		std::string camera_path = ""; //scripted camera for headless runs (see CameraPath.hpp)
+		std::string timings = ""; //if non-empty, write per-frame CPU/GPU timings here
+		std::string screenshot = ""; //if non-empty, save the last headless frame here (PNG)
+		bool software = false; //render on the CPU with SoftwareRenderer (implies headless; no OpenGL at all)
+		std::string record_commands = ""; //if non-empty, save the last frame's render commands here
+		std::string replay = ""; //if non-empty, draw these saved render commands every frame instead of running the game
+		//captured frames are written to capture_prefix + frame number + ".png"
+		// (F12 captures one frame, F11 toggles capturing every frame; --capture captures every frame from the start)
+		std::string capture_prefix = "capture-";
+		bool capture = false;
+		std::string record_video = ""; //if non-empty, record every frame to this uncompressed .y4m file
+		//dynamic resolution renders at output size * [min_scale, max_scale], adjusted to hold GPU time near target_ms:
+		bool dynamic_resolution = false;
+		float min_scale = 0.5f;
+		float max_scale = 1.0f;
+		double target_ms = 14.0;
+		bool sharpen = false; //sharpen when upscaling dynamic resolution frames
+		//OpenGL runs stream textures and meshes in the background (see AssetStreamer.hpp), drawing objects as they
+		// become resident; headless runs wait for everything before the first frame unless 'stream' is set:
+		bool stream = false;
+		//assets come from this package (made by 'cook --package', see AssetPackage.hpp) if it exists,
+		// and otherwise are decoded and processed from the exported files as they load:
+		std::string package = "assets.blob";
+		//the exported (or cooked) files read without a package; pointing these elsewhere (say, at a large
+		// scene made by 'scenegen') also turns off the package:
+		std::string meshes = "meshes.blob";
+		std::string scene = "scene.blob";
+		//threads decoding textures (and reading meshes) at startup; 0 means one per hardware thread:
+		uint32_t load_threads = 0;
+		//textures get full mipmap chains (see Mipmaps.hpp) and are sampled trilinearly; without, just level 0, nearest:
+		bool mipmaps = true;
+		//count the software renderer's texel fetches and misses in a simulated cache (see SoftwareRenderer.hpp):
+		bool texture_cache_stats = false;
+		//watch the exported files and patch changes into the running game (ignores the package):
+		bool hot_reload = false;
 	} config;
 
-	//------------  initialization ------------
-
-	//Initialize SDL library:
-	SDL_Init(SDL_INIT_VIDEO);
-
-	//Ask for an OpenGL context version 3.3, core profile, enable debug:
-	SDL_GL_ResetAttributes();
-	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-
-	//create window:
-	SDL_Window *window = SDL_CreateWindow(
-		config.title.c_str(),
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		config.size.x, config.size.y,
-		SDL_WINDOW_OPENGL /*| SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI*/
-	);
-
-	if (!window) {
-		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--headless" && argi + 1 < argc) {
+			config.headless = true;
+			config.frames = std::stoul(argv[++argi]);
+		} else if (arg == "--camera-path" && argi + 1 < argc) {
+			config.camera_path = argv[++argi];
+		} else if (arg == "--timings" && argi + 1 < argc) {
+			config.timings = argv[++argi];
+		} else if (arg == "--screenshot" && argi + 1 < argc) {
+			config.screenshot = argv[++argi];
+		} else if (arg == "--software") {
+			config.software = true;
+		} else if (arg == "--record-commands" && argi + 1 < argc) {
+			config.record_commands = argv[++argi];
+		} else if (arg == "--replay" && argi + 1 < argc) {
+			config.replay = argv[++argi];
+		} else if (arg == "--capture" && argi + 1 < argc) {
+			config.capture = true;
+			config.capture_prefix = argv[++argi];
+		} else if (arg == "--record-video" && argi + 1 < argc) {
+			config.record_video = argv[++argi];
+		} else if (arg == "--dynamic-resolution" && argi + 2 < argc) {
+			config.dynamic_resolution = true;
+			config.min_scale = std::stof(argv[++argi]);
+			config.max_scale = std::stof(argv[++argi]);
+		} else if (arg == "--target-ms" && argi + 1 < argc) {
+			config.target_ms = std::stod(argv[++argi]);
+		} else if (arg == "--sharpen") {
+			config.sharpen = true;
+		} else if (arg == "--stream") {
+			config.stream = true;
+		} else if (arg == "--package" && argi + 1 < argc) {
+			config.package = argv[++argi];
+		} else if (arg == "--no-package") {
+			config.package = "";
+		} else if (arg == "--meshes" && argi + 1 < argc) {
+			config.meshes = argv[++argi];
+			config.package = "";
+		} else if (arg == "--scene" && argi + 1 < argc) {
+			config.scene = argv[++argi];
+			config.package = "";
+		} else if (arg == "--load-threads" && argi + 1 < argc) {
+			config.load_threads = std::stoul(argv[++argi]);
+		} else if (arg == "--no-mipmaps") {
+			config.mipmaps = false;
+		} else if (arg == "--texture-cache-stats") {
+			config.texture_cache_stats = true;
+		} else if (arg == "--hot-reload") {
+			config.hot_reload = true;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--headless <frames>] [--camera-path <file>] [--timings <file.csv>] [--screenshot <file.png>] [--software]"
+				" [--record-commands <file>] [--replay <file>] [--capture <prefix>] [--record-video <file.y4m>]"
+				" [--dynamic-resolution <min_scale> <max_scale>] [--target-ms <ms>] [--sharpen] [--stream]"
+				" [--package <file> | --no-package] [--meshes <file>] [--scene <file>] [--load-threads <count>] [--no-mipmaps] [--texture-cache-stats] [--hot-reload]" << std::endl;
+			return 1;
+		}
+	}
+	if (config.software && !config.headless) {
+		std::cerr << "--software requires --headless <frames>." << std::endl;
 		return 1;
 	}
-
-	//Create OpenGL context:
-	SDL_GLContext context = SDL_GL_CreateContext(window);
-
-	if (!context) {
-		SDL_DestroyWindow(window);
-		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+	if (config.software && config.record_video != "") {
+		std::cerr << "--record-video reads frames back from OpenGL; it can't be used with --software." << std::endl;
 		return 1;
 	}
-
-	#ifdef _WIN32
-	//On windows, load OpenGL extensions:
-	if (!init_gl_shims()) {
-		std::cerr << "ERROR: failed to initialize shims." << std::endl;
+	if (config.software && config.capture) {
+		std::cerr << "--capture reads frames back from OpenGL; it can't be used with --software (use --screenshot)." << std::endl;
 		return 1;
 	}
-	#endif
+	if (config.software && config.dynamic_resolution) {
+		std::cerr << "--dynamic-resolution is driven by GPU timings; it can't be used with --software." << std::endl;
+		return 1;
+	}
+	if (config.software && config.stream) {
+		std::cerr << "--stream uploads assets with OpenGL; it can't be used with --software." << std::endl;
+		return 1;
+	}
+	if (config.texture_cache_stats && !config.software) {
+		std::cerr << "--texture-cache-stats counts the software renderer's texel fetches; it needs --software." << std::endl;
+		return 1;
+	}
+	if (config.software && (config.record_commands != "" || config.replay != "")) {
+		std::cerr << "--record-commands and --replay need OpenGL (can't be used with --software)." << std::endl;
+		return 1;
+	}
+	if (config.hot_reload && (config.meshes != "meshes.blob" || config.scene != "scene.blob")) {
+		std::cerr << "--hot-reload watches meshes.blob and scene.blob in the current directory; it can't be used with --meshes or --scene." << std::endl;
+		return 1;
+	}
+
+	//------------  initialization ------------
+
+	SDL_Window *window = NULL;
+	SDL_GLContext context = 0;
+	std::unique_ptr< HeadlessContext > headless;
+	std::unique_ptr< ThreadPool > pool;
+	std::unique_ptr< SoftwareRenderer > software;
+
+	if (config.software) {
+		//No OpenGL context at all; frames are rasterized on the CPU:
+		pool.reset(new ThreadPool());
+		software.reset(new SoftwareRenderer(config.size, pool.get()));
+		software->measure_texture_cache = config.texture_cache_stats;
+		std::cout << "Software rendering with " << pool->size() << " threads." << std::endl;
+	} else if (config.headless) {
+		//Create an offscreen OpenGL context (there's nothing to sync to, so no vsync):
+		try {
+			headless.reset(new HeadlessContext(config.size));
+		} catch (std::exception &e) {
+			std::cerr << "Error creating headless OpenGL context: " << e.what() << std::endl;
+			return 1;
+		}
+	} else {
+		//Initialize SDL library:
+		SDL_Init(SDL_INIT_VIDEO);
+
+		//Ask for an OpenGL context version 3.3, core profile, enable debug:
+		SDL_GL_ResetAttributes();
+		SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+		//create window:
+		window = SDL_CreateWindow(
+			config.title.c_str(),
+			SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+			config.size.x, config.size.y,
+			SDL_WINDOW_OPENGL /*| SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI*/
+		);
+
+		if (!window) {
+			std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+			return 1;
+		}
 
-	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
-		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
-		if (SDL_GL_SetSwapInterval(1) != 0) {
-			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+		//Create OpenGL context:
+		context = SDL_GL_CreateContext(window);
+
+		if (!context) {
+			SDL_DestroyWindow(window);
+			std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+			return 1;
+		}
+
+		#ifdef _WIN32
+		//On windows, load OpenGL extensions:
+		if (!init_gl_shims()) {
+			std::cerr << "ERROR: failed to initialize shims." << std::endl;
+			return 1;
+		}
+		#endif
+
+		//Set VSYNC + Late Swap (prevents crazy FPS):
+		if (SDL_GL_SetSwapInterval(-1) != 0) {
+			std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
+			if (SDL_GL_SetSwapInterval(1) != 0) {
+				std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+			}
 		}
 	}
 
@@ -110,41 +268,102 @@ int main(int argc, char **argv) {
 
 	//------------ opengl objects / game assets ------------
 
-	//texture:
-	GLuint tex[NUM_PNG];
-	glm::uvec2 tex_size[NUM_PNG];
-	for (int i = 0; i < NUM_PNG; i++) {
-		tex_size[i] = glm::uvec2(0, 0);
+	//(scene and meshes are declared up here so streamed assets can be hooked up to them as they arrive)
+	Meshes meshes;
+	Scene scene;
+
+	std::unique_ptr< AssetStreamer > streamer;
+	if (!software) {
+		streamer.reset(new AssetStreamer(config.load_threads));
+		streamer->mipmaps = config.mipmaps;
 	}
 
-	{ //load textures : 'This is going to be super dirty
-		std::vector< uint32_t > data[NUM_PNG];
-		//std::vector< uint32_t > data;
+	auto load_start = std::chrono::high_resolution_clock::now();
 
-		//create a texture object:
-		glGenTextures(NUM_PNG, tex);
+	std::unique_ptr< AssetPackage > package;
+	if (config.package != "" && !config.hot_reload && std::ifstream(config.package)) {
+		package.reset(new AssetPackage(config.package));
+		std::cout << "Mapped asset package '" << config.package << "'." << std::endl;
+	}
 
-		for (int i = 0; i < NUM_PNG; i++) {
-			if (!load_png(PNG_LIST[i], &tex_size[i].x, &tex_size[i].y, &data[i], LowerLeftOrigin)) {
-				std::cerr << "Failed to load texture " << PNG_LIST[i] << std::endl;
-				exit(1);
+	//object names are interned once (see NameTable.hpp); per-name data lives in arrays indexed by name id:
+	NameTable names;
+	std::vector< int > name_to_texture; //texture index (-1 if none)
+	std::vector< Scene::Object * > name_to_object; //(nullptr if none)
+	auto set_texture = [&](std::string const &name, int index) {
+		uint32_t id = names.intern(name);
+		name_to_texture.resize(names.size(), -1);
+		name_to_texture[id] = index;
+	};
+
+	//materials (which texture each mesh uses), and the textures they need:
+	std::vector< std::string > texture_files; //(only read without a package)
+	if (package) {
+		for (auto const &material : package->materials) {
+			set_texture(material.first, int(material.second));
+		}
+	} else {
+		for (auto const &material : AssetPackage::default_materials()) {
+			auto f = std::find(texture_files.begin(), texture_files.end(), material.second);
+			set_texture(material.first, int(f - texture_files.begin()));
+			if (f == texture_files.end()) texture_files.emplace_back(material.second);
+		}
+	}
+	int const texture_count = int(package ? package->textures.size() : texture_files.size());
+
+	//texture:
+	std::vector< GLuint > tex(texture_count, 0);
+
+	if (streamer) {
+		//with OpenGL, textures are decoded and uploaded by the streamer; objects using them wait until they arrive:
+		glGenTextures(texture_count, tex.data());
+		for (int i = 0; i < texture_count; i++) {
+			auto on_resident = [&scene, i](){
+				for (auto &object : scene.objects) {
+					if (object.texture_used == i) --object.pending_assets;
+				}
+			};
+			if (package) streamer->stream_texture(package->textures[i], tex[i], on_resident);
+			else streamer->stream_texture(texture_files[i], tex[i], on_resident);
+		}
+	} else {
+		//with the software renderer, PNGs are decoded (and mipmapped) up front, each on its own thread from a pool
+		// (libpng keeps no shared state):
+		software->textures.resize(texture_count);
+		std::vector< glm::uvec2 > tex_size(texture_count, glm::uvec2(0, 0));
+		std::vector< std::vector< uint32_t > > data(texture_count);
+		std::vector< char > decoded(texture_count, 0);
+		std::vector< std::vector< std::vector< uint32_t > > > mipmaps(texture_count);
+		if (!package) {
+			auto before = std::chrono::high_resolution_clock::now();
+			ThreadPool decoders(config.load_threads);
+			for (int i = 0; i < texture_count; i++) {
+				decoders.run([&, i](){
+					decoded[i] = load_png(texture_files[i], &tex_size[i].x, &tex_size[i].y, &data[i], LowerLeftOrigin);
+					if (decoded[i] && config.mipmaps) mipmaps[i] = make_mipmaps(tex_size[i], data[i].data());
+				});
 			}
-			
-			glActiveTexture(GL_TEXTURE0 + i);
-			//bind texture object to GL_TEXTURE_2D:
-			glBindTexture(GL_TEXTURE_2D, tex[i]);
-
-			//upload texture data from data:
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size[i].x, tex_size[i].y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[i][0]);
-
-			std::cout << "i = " << i << " tex[i] = " << tex[i] << std::endl;
-			//set texture sampling parameters:
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			decoders.wait();
+			std::cout << "Decoded " << texture_count << " textures on " << decoders.size() << " threads in "
+				<< std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - before).count() << " ms." << std::endl;
 		}
 
+		for (int i = 0; i < texture_count; i++) {
+			if (package) { //(straight from the package)
+				auto const &levels = package->textures[i].levels;
+				tex_size[i] = levels[0].size;
+				data[i].assign(levels[0].texels, levels[0].texels + levels[0].size.x * levels[0].size.y);
+				for (uint32_t l = 1; l < levels.size() && config.mipmaps; ++l) {
+					mipmaps[i].emplace_back(levels[l].texels, levels[l].texels + levels[l].size.x * levels[l].size.y);
+				}
+			} else if (!decoded[i]) {
+				std::cerr << "Failed to load texture " << texture_files[i] << std::endl;
+				exit(1);
+			}
+			software->textures[i].size = tex_size[i];
+			software->textures[i].data = std::move(data[i]);
+			software->textures[i].mipmaps = std::move(mipmaps[i]);
+		}
 	}
 
 	//shader program:
@@ -156,19 +375,24 @@ int main(int argc, char **argv) {
 	GLuint program_itmv = 0;
 	GLuint program_to_light = 0;
 	GLuint program_tex = 0;
-	{ //compile shader program:
+	if (!software) { //compile shader program:
 		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
 			"#version 330\n"
 			"uniform mat4 mvp;\n"
 			"uniform mat3 itmv;\n"
-			"in vec4 Position;\n"
-			"in vec3 Normal;\n"
+			"in vec4 Position;\n" //quantized to the mesh's bounds (mvp includes the decode)
+			"in vec2 Normal;\n" //octahedral encoding (see Meshes::PackedVertex)
 			"in vec2 UVCoord;\n"
 			"out vec3 normal;\n"
 			"out vec2 uvcoord;\n"
+			"vec3 decode_normal(vec2 oct) {\n"
+			"	vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));\n"
+			"	if (n.z < 0.0) n.xy = (1.0 - abs(oct.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(oct, vec2(0.0)));\n"
+			"	return normalize(n);\n"
+			"}\n"
 			"void main() {\n"
 			"	gl_Position = mvp * Position;\n"
-			"	normal = itmv * Normal;\n"
+			"	normal = itmv * decode_normal(Normal);\n"
 			"	uvcoord = UVCoord;\n"
 			"}\n"
 		);
@@ -211,33 +435,27 @@ int main(int argc, char **argv) {
 		if (program_tex == -1U) throw std::runtime_error("no uniform named tex");
 	}
 
-	//--------- Game constants -------
-	
-	std::map <std::string, int> n2id; // name to index map
-	n2id["Balloon1"] = 0;
-	n2id["Balloon2"] = 1;
-	n2id["Balloon3"] = 2;
-	n2id["Stand"]	 = 3;
-	n2id["Base"]	 = 4;
-	n2id["Link1"]	 = 5;
-	n2id["Link2"]	 = 6;
-	n2id["Link3"]	 = 7;
-	n2id["Crate"] 	 = 9;	// giving crate cube as it's texture is invisible
-	n2id["Cube.001"] = 9;
-	n2id["Crate.001"] = 9;
-	n2id["Crate.002"] = 9;
-	n2id["Crate.003"] = 9;
-	n2id["Crate.004"] = 9;
-	n2id["Crate.005"] = 9;
-	n2id["Balloon1-Pop"] = 0;
-	n2id["Balloon2-Pop"] = 1;
-	n2id["Balloon3-Pop"] = 2;
-
-	std::map <std::string, Scene::Object*> n2o;
-
 	//------------ meshes ------------
 
-	Meshes meshes;
+	//objects added before their mesh is resident, and the name of that mesh:
+	std::vector< std::pair< Scene::Object *, MeshHandle > > waiting_for_mesh;
+	//every object's mesh (to patch objects when meshes are reloaded):
+	std::vector< std::pair< Scene::Object *, MeshHandle > > object_meshes;
+
+	auto attach_mesh = [](Scene::Object &object, Mesh const &mesh) {
+		object.vao = mesh.vao;
+		object.start = mesh.start;
+		object.count = mesh.count;
+		object.index_start = mesh.index_start;
+		object.index_count = mesh.index_count;
+		object.index_type = mesh.index_type;
+		object.box_min = mesh.box_min;
+		object.box_size = mesh.box_size;
+		object.bounds_min = mesh.bounds_min;
+		object.bounds_max = mesh.bounds_max;
+		object.sphere_center = mesh.sphere_center;
+		object.sphere_radius = mesh.sphere_radius;
+	};
 
 	std::cerr << "Loading meshes!" << std::endl;
 	{ //add meshes to database:
@@ -246,92 +464,121 @@ int main(int argc, char **argv) {
 		attributes.Normal = program_Normal;
 		attributes.UVCoord = program_UVCoord;
 
-		meshes.load("meshes.blob", attributes);
+		//(a package holds the meshes' chunks too, so it loads as a mesh file)
+		std::string meshes_file = (package ? config.package : config.meshes);
+		if (software) {
+			meshes.load_cpu(meshes_file);
+		} else {
+			streamer->stream_meshes(meshes_file, &meshes, attributes, [&](){
+				for (auto const &waiting : waiting_for_mesh) {
+					attach_mesh(*waiting.first, meshes.get(waiting.second));
+					--waiting.first->pending_assets;
+				}
+				waiting_for_mesh.clear();
+			});
+		}
 	}
 
-	std::cerr << "Successfully loaded the meshes!" << std::endl;
+	if (software) std::cerr << "Successfully loaded the meshes!" << std::endl;
 	
 	//------------ scene ------------
 
-	Scene scene;
 	//set up camera parameters based on window:
 	scene.camera.fovy = glm::radians(80.0f);
 	scene.camera.aspect = float(config.size.x) / float(config.size.y);
 	scene.camera.near = 0.01f;
 	//(transform will be handled in the update function below)
 
-	//add some objects from the mesh library:
-	auto add_object = [&](std::string const &name, glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale, int &index, GLuint &tex, glm::vec3 const &dimension) -> Scene::Object & {
-		Mesh const &mesh = meshes.get(name);
-		scene.objects.emplace_back();
-		Scene::Object &object = scene.objects.back();
-		object.transform.position = position;
-		object.transform.rotation = rotation;
-		object.transform.scale = scale;
-		object.vao = mesh.vao;
-		object.start = mesh.start;
-		object.count = mesh.count;
+	//add objects from the package (or config.scene) in bulk (see SceneLoader.hpp), then set them up:
+	std::vector< MeshHandle > name_to_mesh; //(resolved once per name, as load_scene() asks about it)
+	auto wanted = [&](uint32_t id) {
+		name_to_texture.resize(names.size(), -1);
+		if (name_to_texture[id] < 0) { //(copies, like 'Crate.001', may use the material of the name they were copied from)
+			uint32_t base = names.find(AssetPackage::material_fallback(names.name(id)));
+			if (base == NameTable::Invalid || base >= name_to_texture.size() || name_to_texture[base] < 0) return false;
+			name_to_texture[id] = name_to_texture[base];
+		}
+		MeshHandle mesh = meshes.handle(names.name(id));
+		if (!streamer && !meshes.has(mesh)) return false; //(streamed meshes aren't resident yet; missing ones are reported when they are)
+		name_to_mesh.resize(names.size());
+		name_to_mesh[id] = mesh;
+		return true;
+	};
+	LoadedScene loaded;
+	if (package) {
+		loaded = load_scene(package->blob, "pst0", &names, wanted, &scene);
+	} else {
+		MappedBlob file(config.scene);
+		loaded = load_scene(file, "str0", &names, wanted, &scene);
+	}
+	name_to_object.resize(names.size(), nullptr);
+	for (uint32_t i = 0; i < loaded.ids.size(); ++i) {
+		Scene::Object &object = scene.objects[loaded.first + i];
+		uint32_t id = loaded.ids[i];
+		MeshHandle mesh = name_to_mesh[id];
+		if (streamer) {
+			//(every streamed asset is still pending here: the streamer only uploads in update() / finish())
+			object.pending_assets = 2; //mesh and texture
+			waiting_for_mesh.emplace_back(&object, mesh);
+		} else {
+			attach_mesh(object, meshes.get(mesh));
+		}
 		object.program = program;
 		object.program_mvp = program_mvp;
 		object.program_itmv = program_itmv;
 		object.program_tex = program_tex;
-		object.tex = tex;
-		object.texture_used = index;
-		object.dimension = dimension;
-		n2o[name] = &object;
-		return object;
-	};
-
-
-	{ //read objects to add from "scene.blob":
-		std::ifstream file("scene.blob", std::ios::binary);
-
-		std::vector< char > strings;
-		//read strings chunk:
-		read_chunk(file, "str0", &strings);
-
-		{ //read scene chunk, add meshes to scene:
-			struct SceneEntry {
-				uint32_t name_begin, name_end;
-				glm::vec3 position;
-				glm::quat rotation;
-				glm::vec3 scale;
-				glm::vec3 dimension;
-			};
-			static_assert(sizeof(SceneEntry) == 60, "Scene entry should be packed");
+		object.texture_used = name_to_texture[id];
+		object.tex = tex[object.texture_used];
+		object_meshes.emplace_back(&object, mesh);
+		name_to_object[id] = &object;
+	}
 
-			std::cout << "scn0 accessed" << std::endl;
+	//scene entries as loaded, so hot reload can tell which ones changed:
+	std::vector< AssetPackage::Object > scene_objects;
+	if (config.hot_reload) {
+		MappedBlob file("scene.blob");
+		AssetPackage::read_scene(file, "str0", &scene_objects);
+	}
 
-			std::vector< SceneEntry > data;
-			read_chunk(file, "scn0", &data);
+	//headless runs (and replays, which refer to meshes and textures by name) draw with everything resident:
+	if (streamer && ((config.headless && !config.stream) || config.replay != "")) {
+		streamer->finish();
+	}
 
-			for (auto const &entry : data) {
-				if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-					throw std::runtime_error("index entry has out-of-range name begin/end");
-				}
-				std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
-				int index = n2id.find(name)->second;
-				std::cout << name << " " << index << " " << tex[index] << std::endl;
-				add_object(name, entry.position, entry.rotation, entry.scale, index, tex[index], entry.dimension);
-			}
+	{ //report load cost (the package, or the mesh and scene files, are memory-mapped, see MappedBlob.hpp):
+		auto load_end = std::chrono::high_resolution_clock::now();
+		if (streamer && streamer->pending()) {
+			std::cout << "Set up scene in " << std::chrono::duration< double, std::milli >(load_end - load_start).count() << " ms ("
+				<< streamer->pending() << " assets still streaming)";
+		} else {
+			std::cout << "Loaded textures, meshes, and scene (" << scene.objects.size() << " objects) in " << std::chrono::duration< double, std::milli >(load_end - load_start).count() << " ms";
 		}
+		long rss = peak_rss_kb();
+		if (rss) std::cout << "; peak RSS so far " << rss << " kB";
+		std::cout << "." << std::endl;
 	}
 
+	//objects the game moves (looked up by name once, here):
+	auto object_named = [&](std::string const &name) -> Scene::Object * {
+		uint32_t id = names.find(name);
+		if (id == NameTable::Invalid || id >= name_to_object.size() || !name_to_object[id]) {
+			throw std::runtime_error("scene has no object named '" + name + "'");
+		}
+		return name_to_object[id];
+	};
+	Scene::Object *balloons[3] = { object_named(B1), object_named(B2), object_named(B3) };
+	Scene::Object *base = object_named(BASE);
+	Scene::Object *stand = object_named(STAND);
+	Scene::Object *link1 = object_named(LINK1);
+	Scene::Object *link2 = object_named(LINK2);
+	Scene::Object *link3 = object_named(LINK3);
+
 	//------- manually creating heirarchy ----------
 	
-	Scene::Object *tmp1, *tmp2;
-	tmp1 = n2o.find(BASE)->second;
-	tmp2 = n2o.find(STAND)->second;
-	tmp1->transform.set_parent(&(tmp2->transform));
-	tmp2 = tmp1;
-	tmp1 = n2o.find(LINK1)->second;
-	tmp1->transform.set_parent(&(tmp2->transform));
-	tmp2 = tmp1;
-	tmp1 = n2o.find(LINK2)->second;
-	tmp1->transform.set_parent(&(tmp2->transform));
-	tmp2 = tmp1;
-	tmp1 = n2o.find(LINK3)->second;
-	tmp1->transform.set_parent(&(tmp2->transform));
+	base->transform.set_parent(&(stand->transform));
+	link1->transform.set_parent(&(base->transform));
+	link2->transform.set_parent(&(link1->transform));
+	link3->transform.set_parent(&(link2->transform));
 
 
 	/*
@@ -361,8 +608,7 @@ int main(int argc, char **argv) {
 
 	//------------ game state -----------
 	
-	int number_of_balloons = 3;
-	bool balloon_dir[number_of_balloons];
+	bool balloon_dir[3] = { false, false, false };
 
 	//------------ game loop ------------
 
@@ -372,34 +618,196 @@ int main(int argc, char **argv) {
 	float rho = 0.0f;
 	float gamma = 0.0f;
 
+	//headless runs follow a scripted camera path and advance time at a fixed rate:
+	CameraPath camera_path;
+	if (config.headless) {
+		if (config.camera_path != "") {
+			camera_path.load(config.camera_path);
+		} else {
+			camera_path = CameraPath::orbit(config.frames / 60.0f);
+		}
+	}
+
+	//replaying a captured frame skips the game update and scene traversal entirely:
+	std::unique_ptr< RenderCommands > replay;
+	if (config.replay != "") {
+		replay.reset(new RenderCommands());
+		try {
+			replay->load(config.replay);
+			validate_gl(*replay);
+		} catch (std::exception &e) {
+			std::cerr << "Can't replay '" << config.replay << "': " << e.what() << std::endl;
+			exit(1);
+		}
+		std::cout << "Replaying " << replay->commands.size() << " commands from '" << config.replay << "'." << std::endl;
+	}
+
+	//frame capture reads back asynchronously and encodes PNGs on a worker thread (started by the first capture):
+	std::unique_ptr< FrameCapture > capture;
+	bool capture_next = false;
+	auto start_capture = [&capture, &config](){
+		if (!capture) capture.reset(new FrameCapture(config.size, config.capture_prefix));
+	};
+	if (config.capture) {
+		start_capture();
+		capture->continuous = true;
+	}
+
+	//video recording reads back every frame and converts/writes it on a worker thread:
+	std::unique_ptr< VideoRecorder > recorder;
+	if (config.record_video != "") {
+		recorder.reset(new VideoRecorder(config.size, config.record_video));
+	}
+
+	//dynamic resolution needs GPU frame times, so it also turns on the frame timer:
+	std::unique_ptr< DynamicResolution > dynamic_resolution;
+	uint32_t dynamic_resolution_results = 0; //frame_timer->gpu_results last passed to the controller
+	if (config.dynamic_resolution) {
+		dynamic_resolution.reset(new DynamicResolution(config.size, config.min_scale, config.max_scale, config.target_ms));
+		dynamic_resolution->sharpen = config.sharpen;
+	}
+
+	std::unique_ptr< FrameTimer > frame_timer;
+	if (config.timings != "" || dynamic_resolution) {
+		//(dynamic resolution only needs the latest GPU time, so the full history is kept just for --timings)
+		frame_timer.reset(new FrameTimer(!software, config.timings != ""));
+	}
+
+	//hot reload: re-read exported files as they are rewritten, patching just what changed into place
+	// (meshes over their old buffer ranges, where they fit; see Meshes::reload()):
+	std::unique_ptr< FileWatcher > watcher;
+	if (config.hot_reload) {
+		watcher.reset(new FileWatcher("."));
+		watcher->watch("meshes.blob");
+		watcher->watch("scene.blob");
+		for (auto const &file : texture_files) {
+			watcher->watch(file);
+		}
+		std::cout << "Watching meshes.blob, scene.blob, and " << texture_files.size() << " textures for changes." << std::endl;
+	}
+	std::vector< uint32_t > tex_reloads(tex.size(), 0); //reloads started, per texture
+	std::vector< uint32_t > tex_installed(tex.size(), 0); //latest reload now in tex[]
+	auto reload = [&](std::string const &changed) {
+		if (changed == "meshes.blob") {
+			std::vector< MeshHandle > handles = meshes.reload(changed);
+			for (auto const &object_mesh : object_meshes) {
+				for (auto const &handle : handles) {
+					if (handle.index == object_mesh.second.index) attach_mesh(*object_mesh.first, meshes.get(handle));
+				}
+			}
+		} else if (changed == "scene.blob") {
+			//patch the transforms of objects whose entries changed (objects are added and removed by restarting):
+			std::vector< AssetPackage::Object > reloaded;
+			MappedBlob file(changed);
+			AssetPackage::read_scene(file, "str0", &reloaded);
+			uint32_t patched = 0;
+			for (auto const &entry : reloaded) {
+				auto old = std::find_if(scene_objects.begin(), scene_objects.end(), [&entry](AssetPackage::Object const &o){ return o.name == entry.name; });
+				uint32_t id = names.find(entry.name);
+				if (old == scene_objects.end() || id == NameTable::Invalid || id >= name_to_object.size() || !name_to_object[id]) {
+					std::cerr << "WARNING: new scene object '" << entry.name << "' won't appear until the game restarts." << std::endl;
+					continue;
+				}
+				if (old->position == entry.position && glm::vec4(old->rotation.x, old->rotation.y, old->rotation.z, old->rotation.w) == glm::vec4(entry.rotation.x, entry.rotation.y, entry.rotation.z, entry.rotation.w) && old->scale == entry.scale && old->dimension == entry.dimension) continue;
+				Scene::Object &object = *name_to_object[id];
+				object.transform.position = entry.position;
+				object.transform.rotation = entry.rotation;
+				object.transform.scale = entry.scale;
+				object.dimension = entry.dimension;
+				*old = entry;
+				++patched;
+			}
+			std::cout << "Reloaded '" << changed << "': " << patched << " objects moved." << std::endl;
+		} else {
+			int i = int(std::find(texture_files.begin(), texture_files.end(), changed) - texture_files.begin());
+			if (software) {
+				SoftwareRenderer::Texture texture;
+				if (!load_png(changed, &texture.size.x, &texture.size.y, &texture.data, LowerLeftOrigin)) {
+					throw std::runtime_error("not a readable PNG");
+				}
+				if (config.mipmaps) texture.mipmaps = make_mipmaps(texture.size, texture.data.data());
+				software->textures[i] = std::move(texture);
+			} else {
+				//streamed into a new texture name that replaces the old one once every level is resident, so objects
+				// draw the old texels until then (a half-written or broken PNG leaves them for good; of overlapping
+				// reloads of one texture, the latest wins):
+				GLuint fresh = 0;
+				glGenTextures(1, &fresh);
+				uint32_t generation = ++tex_reloads[i];
+				streamer->stream_texture(changed, fresh, [&tex, &tex_installed, &scene, i, fresh, generation](){
+					if (generation < tex_installed[i]) { //(a later reload got there first)
+						glDeleteTextures(1, &fresh);
+						return;
+					}
+					tex_installed[i] = generation;
+					glDeleteTextures(1, &tex[i]);
+					tex[i] = fresh;
+					for (auto &object : scene.objects) {
+						if (object.texture_used == i) object.tex = fresh;
+					}
+				}, [changed, fresh](std::string const &what){
+					glDeleteTextures(1, &fresh);
+					std::cerr << "WARNING: failed to reload '" << changed << "': " << what << std::endl;
+				});
+			}
+			std::cout << "Reloaded '" << changed << "'." << std::endl;
+		}
+	};
+
+	uint32_t frame = 0;
 	while (true) {
-		static SDL_Event evt;
-		while (SDL_PollEvent(&evt) == 1) {
-			//handle input:
-			if (evt.type == SDL_MOUSEMOTION) {
-				glm::vec2 old_mouse = mouse;
-				mouse.x = (evt.motion.x + 0.5f) / float(config.size.x) * 2.0f - 1.0f;
-				mouse.y = (evt.motion.y + 0.5f) / float(config.size.y) *-2.0f + 1.0f;
-				if (evt.motion.state & SDL_BUTTON(SDL_BUTTON_LEFT)) {
-					camera.elevation += -2.0f * (mouse.y - old_mouse.y);
-					camera.azimuth += -2.0f * (mouse.x - old_mouse.x);
+		if (config.headless) {
+			if (frame >= config.frames) break;
+		} else {
+			static SDL_Event evt;
+			while (SDL_PollEvent(&evt) == 1) {
+				//handle input:
+				if (evt.type == SDL_MOUSEMOTION) {
+					glm::vec2 old_mouse = mouse;
+					mouse.x = (evt.motion.x + 0.5f) / float(config.size.x) * 2.0f - 1.0f;
+					mouse.y = (evt.motion.y + 0.5f) / float(config.size.y) *-2.0f + 1.0f;
+					if (evt.motion.state & SDL_BUTTON(SDL_BUTTON_LEFT)) {
+						camera.elevation += -2.0f * (mouse.y - old_mouse.y);
+						camera.azimuth += -2.0f * (mouse.x - old_mouse.x);
+					}
+				} else if (evt.type == SDL_MOUSEBUTTONDOWN) {
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_ESCAPE) {
+					should_quit = true;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F12) {
+					start_capture();
+					capture_next = true;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F11) {
+					start_capture();
+					capture->continuous = !capture->continuous;
+				} else if (evt.type == SDL_QUIT) {
+					should_quit = true;
+					break;
 				}
-			} else if (evt.type == SDL_MOUSEBUTTONDOWN) {
-			} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_ESCAPE) {
-				should_quit = true;
-			} else if (evt.type == SDL_QUIT) {
-				should_quit = true;
-				break;
 			}
+			if (should_quit) break;
+		}
+
+		if (frame_timer) frame_timer->begin_frame();
+		if (dynamic_resolution && frame_timer->gpu_results != dynamic_resolution_results) {
+			dynamic_resolution_results = frame_timer->gpu_results;
+			dynamic_resolution->update(frame_timer->latest_gpu_ms);
 		}
-		if (should_quit) break;
 
 		auto current_time = std::chrono::high_resolution_clock::now();
 		static auto previous_time = current_time;
 		float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 		previous_time = current_time;
+		if (config.headless) {
+			elapsed = 1.0f / 60.0f; //fixed time step keeps headless runs repeatable
+
+			CameraPath::Keyframe key = camera_path.sample(frame * elapsed);
+			camera.radius = key.radius;
+			camera.elevation = key.elevation;
+			camera.azimuth = key.azimuth;
+			camera.target = key.target;
+		}
 
-		{ //update game state:
+		if (!replay) { //update game state:
 			//tree stack:
 			/*
 			for (uint32_t i = 0; i < tree_stack.size(); ++i) {
@@ -416,7 +824,7 @@ int main(int argc, char **argv) {
 			// update balloon positions
 			Scene::Object *obj;
 
-			obj = n2o.find(B1)->second;
+			obj = balloons[0];
 			if (obj->transform.position.z - obj->dimension.z < -0.5f) {
 				balloon_dir[0] = true;
 			} else if (obj->transform.position.z - obj->dimension.z / 2 > 5.0f) {
@@ -424,7 +832,7 @@ int main(int argc, char **argv) {
 			}
 			obj->transform.position.z += (balloon_dir[0] ? 1 : -1) * elapsed * 1.0;
 
-			obj = n2o.find(B2)->second;
+			obj = balloons[1];
 			if (obj->transform.position.z - obj->dimension.z < -0.5f) {
 				balloon_dir[1] = true;
 			} else if (obj->transform.position.z - obj->dimension.z / 2 > 5.0f) {
@@ -432,7 +840,7 @@ int main(int argc, char **argv) {
 			}
 			obj->transform.position.z += (balloon_dir[1] ? 1 : -1) * elapsed * 1.0;
 
-			obj = n2o.find(B3)->second;
+			obj = balloons[2];
 			if (obj->transform.position.z - obj->dimension.z < -0.5f) {
 				balloon_dir[2] = true;
 			} else if (obj->transform.position.z - obj->dimension.z / 2 > 5.0f) {
@@ -441,8 +849,9 @@ int main(int argc, char **argv) {
 			obj->transform.position.z += (balloon_dir[2] ? 1 : -1) * elapsed * 1.0;
 			
 
-			obj = n2o.find(LINK3)->second;
-			auto *keystate = SDL_GetKeyboardState(NULL);
+			obj = link3;
+			static Uint8 const no_keys[SDL_NUM_SCANCODES] = { 0 };
+			Uint8 const *keystate = (config.headless ? no_keys : SDL_GetKeyboardState(NULL));
 			if (keystate[SDL_SCANCODE_Z]) {
 				if (theta < M_PI / 2) {
 					theta += elapsed * 0.2f;
@@ -460,7 +869,7 @@ int main(int argc, char **argv) {
 
 			}
 
-			obj = n2o.find(LINK2)->second;
+			obj = link2;
 			if (keystate[SDL_SCANCODE_A]) {
 				if (theta < M_PI / 2) {
 					phi += elapsed * 0.2f;
@@ -478,7 +887,7 @@ int main(int argc, char **argv) {
 					glm::vec3(1.0f, 0.0f, 0.0f));
 			}
 
-			obj = n2o.find(LINK1)->second;
+			obj = link1;
 			if (keystate[SDL_SCANCODE_PERIOD]) {
 				if (theta < M_PI / 2) {
 					rho += elapsed * 0.2f;
@@ -495,7 +904,7 @@ int main(int argc, char **argv) {
 					glm::vec3(1.0f, 0.0f, 0.0f));
 			}
 
-			obj = n2o.find(BASE)->second;
+			obj = base;
 			if (keystate[SDL_SCANCODE_SEMICOLON]) {
 				if (theta < M_PI / 2) {
 					gamma += elapsed * 0.2f;
@@ -531,32 +940,140 @@ int main(int argc, char **argv) {
 
 		
 
+		if (watcher) {
+			for (auto const &changed : watcher->poll()) {
+				try {
+					reload(changed);
+				} catch (std::exception &e) {
+					std::cerr << "WARNING: failed to reload '" << changed << "': " << e.what() << std::endl;
+				}
+			}
+		}
+
+		//upload streamed assets (for a few milliseconds at most; objects appear as they become resident):
+		if (streamer) streamer->update();
+
 		//draw output:
-		glClearColor(0.5, 0.5, 0.5, 0.0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glm::vec3 to_light = glm::normalize(glm::vec3(0.0f, 1.0f, 10.0f));
+		if (software) {
+			software->clear_color = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+			software->to_light = to_light;
+			software->render(scene, meshes);
+		} else {
+			if (dynamic_resolution) dynamic_resolution->bind();
+			else if (headless) headless->bind();
+			glClearColor(0.5, 0.5, 0.5, 0.0);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+			{ //draw game state:
+				glUseProgram(program);
+				glUniform3fv(program_to_light, 1, glm::value_ptr(to_light));
+				if (replay) {
+					execute_gl(*replay);
+				} else {
+					scene.render();
+				}
+			}
+
+			if (dynamic_resolution) dynamic_resolution->present(headless ? headless->framebuffer : 0);
+		}
+
+		if (capture) {
+			if (capture->continuous || capture_next) capture->capture(frame);
+			capture_next = false;
+			capture->update();
+		}
+		if (recorder) {
+			recorder->record(frame);
+			recorder->update();
+		}
 
+		if (frame_timer) frame_timer->end_frame();
 
-		{ //draw game state:
-			glUseProgram(program);
-			glUniform3fv(program_to_light, 1, glm::value_ptr(glm::normalize(glm::vec3(0.0f, 1.0f, 10.0f))));
-			scene.render();
+		if (window) SDL_GL_SwapWindow(window);
+		++frame;
+	}
+
+	capture.reset(); //(finishes writing any captured frames)
+	recorder.reset(); //(likewise for recorded video)
+	dynamic_resolution.reset();
+
+	if (frame_timer) {
+		frame_timer->finish();
+		double cpu_ms = 0.0, gpu_ms = 0.0;
+		std::vector< double > cpu_sorted, gpu_sorted;
+		for (auto const &sample : frame_timer->samples) {
+			cpu_ms += sample.cpu_ms;
+			gpu_ms += sample.gpu_ms;
+			cpu_sorted.emplace_back(sample.cpu_ms);
+			gpu_sorted.emplace_back(sample.gpu_ms);
 		}
+		if (!frame_timer->samples.empty() && frame_timer->history) {
+			//(the average, plus the median and 99th percentile, which show hitches the average hides)
+			auto percentiles = [](std::vector< double > &times) {
+				std::sort(times.begin(), times.end());
+				std::ostringstream str;
+				str << " (median " << times[times.size() / 2] << " ms, 99th percentile " << times[(times.size() * 99) / 100] << " ms)";
+				return str.str();
+			};
+			std::cout << "Rendered " << frame_timer->samples.size() << " frames; average CPU " << cpu_ms / frame_timer->samples.size() << " ms" << percentiles(cpu_sorted);
+			if (frame_timer->gpu) std::cout << ", GPU " << gpu_ms / frame_timer->samples.size() << " ms" << percentiles(gpu_sorted);
+			std::cout << " per frame";
+			long rss = peak_rss_kb();
+			if (rss) std::cout << "; peak RSS " << rss << " kB";
+			std::cout << "." << std::endl;
+		}
+		if (config.timings != "") frame_timer->write_csv(config.timings);
+		frame_timer.reset();
+	}
+
+	if (software && software->measure_texture_cache) {
+		SoftwareRenderer::TextureCacheStats const &stats = software->texture_cache;
+		double pixels = double(std::max< uint64_t >(stats.pixels, 1));
+		std::cout << "Texture cache (" << (config.mipmaps ? "mipmapped" : "no mipmaps") << "): " << stats.pixels << " textured pixels, "
+			<< stats.fetches / pixels << " texels and " << stats.misses / pixels << " misses per pixel ("
+			<< 100.0 * stats.misses / double(std::max< uint64_t >(stats.fetches, 1)) << "% of fetches miss; "
+			<< 64.0 * stats.misses / pixels << " bytes read per pixel)." << std::endl;
+	}
 
+	if (config.record_commands != "") {
+		scene.commands.save(config.record_commands);
+		std::cout << "Wrote " << scene.commands.commands.size() << " commands to '" << config.record_commands << "'." << std::endl;
+	}
 
-		SDL_GL_SwapWindow(window);
+	if (config.screenshot != "" && config.headless) { //save last frame:
+		if (software) {
+			save_png(config.screenshot, config.size.x, config.size.y, software->color.data(), LowerLeftOrigin);
+		} else {
+			std::vector< uint32_t > pixels(config.size.x * config.size.y);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, config.size.x, config.size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			save_png(config.screenshot, config.size.x, config.size.y, pixels.data(), LowerLeftOrigin);
+		}
+		std::cout << "Wrote " << config.screenshot << std::endl;
 	}
 
 
 	//------------  teardown ------------
 
-	SDL_GL_DeleteContext(context);
-	context = 0;
+	streamer.reset(); //(needs the GL context)
+	meshes.arenas.clear(); //(so does this)
+
+	if (software) {
+		software.reset();
+		pool.reset();
+	} else if (headless) {
+		headless.reset();
+	} else {
+		SDL_GL_DeleteContext(context);
+		context = 0;
 
-	SDL_DestroyWindow(window);
-	window = NULL;
+		SDL_DestroyWindow(window);
+		window = NULL;
+	}
 
 	return 0;
 }
@@ -604,3 +1121,17 @@ static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader) {
 	}
 	return program;
 }
+
+static long peak_rss_kb() {
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; //(bytes on OSX)
+	#else
+	return usage.ru_maxrss;
+	#endif
+#endif
+}
@@ -12,6 +12,11 @@ import sys
 
 import bpy
 import struct
+import math
+
+#write quantized vertices ('qv16' + 'box0' chunks, 16 bytes per vertex) instead of floats ('v3n3', 32 bytes)?
+# (see Meshes.hpp for the format; Meshes::load reads either)
+quantize = False
 
 #bpy.ops.wm.open_mainfile(filepath='island.blend')
 bpy.ops.wm.open_mainfile(filepath='robot.blend')
@@ -53,6 +58,26 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#boxes gives the bounds each mesh's positions are quantized against (only when quantizing):
+boxes = b''
+
+def pack_quantized(verts):
+    lo = [min(v[0][i] for v in verts) for i in range(3)]
+    hi = [max(v[0][i] for v in verts) for i in range(3)]
+    size = [hi[i] - lo[i] for i in range(3)]
+    out = b''
+    for (co, no, uv) in verts:
+        q = [int(round(min(1.0, max(0.0, (co[i] - lo[i]) / size[i])) * 65535.0)) if size[i] > 0.0 else 0 for i in range(3)]
+        out += struct.pack('4H', q[0], q[1], q[2], 0)
+        #octahedral normal:
+        l1 = abs(no[0]) + abs(no[1]) + abs(no[2])
+        ox, oy = (no[0] / l1, no[1] / l1) if l1 > 0.0 else (0.0, 0.0)
+        if l1 > 0.0 and no[2] < 0.0:
+            ox, oy = (1.0 - abs(oy)) * (1.0 if ox >= 0.0 else -1.0), (1.0 - abs(ox)) * (1.0 if oy >= 0.0 else -1.0)
+        out += struct.pack('2h', int(round(max(-1.0, min(1.0, ox)) * 32767.0)), int(round(max(-1.0, min(1.0, oy)) * 32767.0)))
+        out += struct.pack('2e', uv[0], uv[1])
+    return out, struct.pack('6f', lo[0], lo[1], lo[2], size[0], size[1], size[2])
+
 vertex_count = 0
 for name in to_write:
     print("Writing '" + name + "'...")
@@ -106,21 +131,30 @@ for name in to_write:
 
 
     #write the mesh:
+    verts = []
     for poly in mesh.polygons:
         for vert, loop in zip(poly.vertices, poly.loop_indices):
-            for item in mesh.vertices[vert].co:  # vertex
-                data += struct.pack("f",item)
-            for item in mesh.vertices[vert].normal:  # normal
-                data += struct.pack("f",item)
-            for item in (mesh.uv_layers.active.data[loop].uv if mesh.uv_layers.active is not None else (0.0, 0.0)):  # uv
-                data += struct.pack("f",item)
+            verts.append((
+                tuple(mesh.vertices[vert].co), # vertex
+                tuple(mesh.vertices[vert].normal), # normal
+                tuple(mesh.uv_layers.active.data[loop].uv if mesh.uv_layers.active is not None else (0.0, 0.0)) # uv
+            ))
+    if quantize:
+        packed, box = pack_quantized(verts)
+        data += packed
+        boxes += box
+    else:
+        for (co, no, uv) in verts:
+            data += struct.pack('3f', *co)
+            data += struct.pack('3f', *no)
+            data += struct.pack('2f', *uv)
 
     vertex_count += len(mesh.polygons) * 3
 #######################################################
 
 
 #check that we wrote as much data as anticipated:
-assert(vertex_count * (3 * 4 + 3 * 4 + 2 * 4) == len(data))
+assert(vertex_count * (16 if quantize else 3 * 4 + 3 * 4 + 2 * 4) == len(data))
 
 print("size")
 print(len(data))
@@ -128,7 +162,7 @@ print(len(data))
 #write the data chunk and index chunk to an output blob:
 blob = open('../dist/meshes.blob', 'wb')
 #first chunk: the data
-blob.write(struct.pack('4s',b'v3n3')) #type
+blob.write(struct.pack('4s',b'qv16' if quantize else b'v3n3')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
 #second chunk: the strings
@@ -139,6 +173,11 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'idx0')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
+if quantize:
+    #fourth chunk: the bounds
+    blob.write(struct.pack('4s',b'box0')) #type
+    blob.write(struct.pack('I', len(boxes))) #length
+    blob.write(boxes)
 
 print("Wrote " + str(blob.tell()) + " bytes to meshes.blob")
 
@@ -3,13 +3,21 @@
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <string>
 #include <cassert>
+#include <stdint.h>
+#include <stddef.h>
 
-template< typename T >
-void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
-	assert(_to);
-	auto &to = *_to;
+//Chunks are an 8-byte header (four-character magic, data size in bytes) followed by the data.
+//read_chunk() is split in two so the data can go straight into memory the caller already has
+// (an arena, a mapped buffer, ...): read_chunk_size() reads the header, then read_chunk_data()
+// reads the elements into 'count' elements of storage (which needn't be initialized, but must
+// be aligned for T). Nothing is logged; failures throw.
 
+//read a chunk header and return the number of T's in the chunk:
+// note: will throw if the header can't be read, has the wrong magic, or isn't a whole number of T's.
+template< typename T >
+size_t read_chunk_size(std::istream &from, std::string const &magic) {
 	struct ChunkHeader {
 		char magic[4] = {'\0', '\0', '\0', '\0' };
 		uint32_t size = 0;
@@ -18,21 +26,58 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 
 	ChunkHeader header;
 	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
-		throw std::runtime_error("Failed to read chunk header");
+		throw std::runtime_error("Failed to read header of chunk '" + magic + "'.");
 	}
-	std::cout << "header size = " << header.size << std::endl;
-	std::cout << "magic" << magic << std::endl;
 	if (std::string(header.magic,4) != magic) {
-		throw std::runtime_error("Unexpected magic number in chunk");
-		std::cout << "header" << header.magic << std::endl;
+		throw std::runtime_error("Unexpected magic number in chunk (expected '" + magic + "', found '" + std::string(header.magic,4) + "').");
+	}
+
+	//(on streams that can seek, check the data is all there before anyone allocates room for it)
+	std::streampos at = from.tellg();
+	if (at != std::streampos(-1)) {
+		from.seekg(0, std::ios::end);
+		std::streampos end = from.tellg();
+		from.seekg(at);
+		if (end != std::streampos(-1) && uint64_t(end - at) < header.size) {
+			throw std::runtime_error("Chunk '" + magic + "' is truncated (" + std::to_string(uint64_t(end - at)) + " of " + std::to_string(header.size) + " bytes are present).");
+		}
 	}
 
 	if (header.size % sizeof(T) != 0) {
-		throw std::runtime_error("Size of chunk not divisible by element size");
+		throw std::runtime_error("Size of chunk '" + magic + "' (" + std::to_string(header.size) + " bytes) not divisible by element size (" + std::to_string(sizeof(T)) + " bytes).");
 	}
+	return header.size / sizeof(T);
+}
 
-	to.resize(header.size / sizeof(T));
-	if (!from.read(reinterpret_cast< char * >(&to[0]), to.size() * sizeof(T))) {
+//read the data of the chunk whose header was just read:
+// note: will throw if the data is cut short.
+template< typename T >
+void read_chunk_data(std::istream &from, size_t count, T *to) {
+	assert(to || count == 0);
+	assert(reinterpret_cast< uintptr_t >(to) % alignof(T) == 0);
+	if (count && !from.read(reinterpret_cast< char * >(to), count * sizeof(T))) {
 		throw std::runtime_error("Failed to read chunk data.");
 	}
 }
+
+//read a chunk into room for 'capacity' T's, returning how many were read:
+// note: will throw as above, or if the chunk holds more than 'capacity' T's.
+template< typename T >
+size_t read_chunk(std::istream &from, std::string const &magic, T *to, size_t capacity) {
+	size_t count = read_chunk_size< T >(from, magic);
+	if (count > capacity) {
+		throw std::runtime_error("Chunk '" + magic + "' holds " + std::to_string(count) + " elements, but there is only room for " + std::to_string(capacity) + ".");
+	}
+	read_chunk_data(from, count, to);
+	return count;
+}
+
+//read a chunk into a vector (which value-initializes its elements before they are read over):
+template< typename T >
+void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *_to) {
+	assert(_to);
+	auto &to = *_to;
+
+	to.resize(read_chunk_size< T >(from, magic));
+	read_chunk_data(from, to.size(), to.data());
+}
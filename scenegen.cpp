@@ -0,0 +1,245 @@
+#include "Meshes.hpp"
+#include "AssetPackage.hpp"
+#include "BlobWriter.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+//"scenegen" writes synthetic scenes, as large as you like, for finding where loading and drawing stop scaling:
+// a cooked mesh file and a scene file that the game loads with --meshes and --scene (see README).
+//The game's own meshes and scene (read from --from) come first, so the game runs as usual around them;
+// then come --objects generated objects:
+// - drawing --objects-per-mesh copies of each generated mesh (a box, subdivided 1-4 times per side,
+//   of random size), so the number of distinct meshes is --objects / --objects-per-mesh;
+// - in chains of --depth objects, each parented to the one before it ('prn0', see AssetPackage.hpp);
+// - with chains placed in a square --extent units across, uniformly, in clusters, or on a grid.
+//Generated meshes are named after the game's meshes ('Crate.g17'), so they are drawn with the same
+// materials (see AssetPackage::material_fallback()).
+//Makes no OpenGL calls.
+
+//a box of 'size', centered on the origin, with each face split into 'split' x 'split' quads:
+static void make_box(uint32_t split, glm::vec3 size, std::vector< Meshes::Vertex > *vertices, std::vector< uint32_t > *indices) {
+	for (uint32_t axis = 0; axis < 3; ++axis) {
+		for (float sign = -1.0f; sign <= 1.0f; sign += 2.0f) {
+			glm::vec3 normal = glm::vec3(0.0f);
+			normal[axis] = sign;
+			glm::vec3 u = glm::vec3(0.0f), v = glm::vec3(0.0f);
+			u[(axis + 1) % 3] = sign;
+			v[(axis + 2) % 3] = 1.0f;
+			uint32_t base = uint32_t(vertices->size());
+			for (uint32_t y = 0; y <= split; ++y) {
+				for (uint32_t x = 0; x <= split; ++x) {
+					glm::vec2 uv = glm::vec2(x, y) / float(split);
+					Meshes::Vertex vertex;
+					vertex.Position = 0.5f * size * (normal + (2.0f * uv.x - 1.0f) * u + (2.0f * uv.y - 1.0f) * v);
+					vertex.Normal = normal;
+					vertex.UVCoord = uv;
+					vertices->emplace_back(vertex);
+				}
+			}
+			for (uint32_t y = 0; y < split; ++y) {
+				for (uint32_t x = 0; x < split; ++x) {
+					uint32_t a = base + y * (split + 1) + x;
+					uint32_t b = a + 1, c = a + (split + 1), d = c + 1;
+					indices->insert(indices->end(), { a, b, d, a, d, c });
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	std::string from = ".";
+	uint32_t objects = 10000;
+	uint32_t objects_per_mesh = 10;
+	uint32_t depth = 1;
+	std::string layout = "uniform";
+	float extent = 200.0f;
+	uint32_t seed = 1;
+	bool compress = false;
+	std::string meshes_out, scene_out;
+	bool usage = false;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--from" && argi + 1 < argc) {
+			from = argv[++argi];
+		} else if (arg == "--objects" && argi + 1 < argc) {
+			objects = std::stoul(argv[++argi]);
+		} else if (arg == "--objects-per-mesh" && argi + 1 < argc) {
+			objects_per_mesh = std::max(1UL, std::stoul(argv[++argi]));
+		} else if (arg == "--depth" && argi + 1 < argc) {
+			depth = std::max(1UL, std::stoul(argv[++argi]));
+		} else if (arg == "--layout" && argi + 1 < argc) {
+			layout = argv[++argi];
+			if (layout != "uniform" && layout != "clusters" && layout != "grid") usage = true;
+		} else if (arg == "--extent" && argi + 1 < argc) {
+			extent = std::stof(argv[++argi]);
+		} else if (arg == "--seed" && argi + 1 < argc) {
+			seed = std::stoul(argv[++argi]);
+		} else if (arg == "--compress") {
+			compress = true;
+		} else if (meshes_out == "") {
+			meshes_out = arg;
+		} else if (scene_out == "") {
+			scene_out = arg;
+		} else {
+			usage = true;
+		}
+	}
+	if (usage || meshes_out == "" || scene_out == "") {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--from <asset dir>] [--objects <count>] [--objects-per-mesh <count>] [--depth <levels>]"
+			" [--layout uniform|clusters|grid] [--extent <units>] [--seed <seed>] [--compress] <out meshes.blob> <out scene.blob>" << std::endl;
+		return 1;
+	}
+
+	try {
+		std::mt19937 mt(seed);
+		auto random = [&mt](float lo, float hi) {
+			return std::uniform_real_distribution< float >(lo, hi)(mt);
+		};
+
+		//------ meshes: the game's (cooked as by 'cook'), then the generated boxes ------
+		Meshes::File file;
+		file.read(from + "/meshes.blob");
+		file.quantize();
+		if (file.indices.empty()) {
+			file.weld();
+			file.optimize();
+		}
+		file.blob->wait_verified();
+
+		std::vector< Meshes::PackedVertex > packed(file.packed.begin(), file.packed.end());
+		std::vector< uint32_t > indices(file.indices.begin(), file.indices.end());
+		uint32_t const mesh_count = (objects + objects_per_mesh - 1) / objects_per_mesh;
+		auto const &materials = AssetPackage::default_materials();
+		std::vector< std::string > mesh_names;
+		mesh_names.reserve(mesh_count);
+		file.entries.reserve(file.entries.size() + mesh_count);
+		std::vector< Meshes::Vertex > vertices;
+		std::vector< uint32_t > box_indices;
+		for (uint32_t m = 0; m < mesh_count; ++m) {
+			vertices.clear();
+			box_indices.clear();
+			make_box(1 + m % 4, glm::vec3(random(0.2f, 1.0f), random(0.2f, 1.0f), random(0.2f, 1.0f)), &vertices, &box_indices);
+
+			Meshes::Box box;
+			glm::vec3 min = vertices[0].Position, max = vertices[0].Position;
+			for (auto const &vertex : vertices) {
+				min = glm::min(min, vertex.Position);
+				max = glm::max(max, vertex.Position);
+			}
+			box.min = min;
+			box.size = max - min;
+
+			Mesh mesh;
+			mesh.start = GLuint(packed.size());
+			mesh.count = GLuint(vertices.size());
+			mesh.index_start = GLuint(indices.size());
+			mesh.index_count = GLuint(box_indices.size());
+			mesh.box_min = box.min;
+			mesh.box_size = box.size;
+			for (auto const &vertex : vertices) {
+				packed.emplace_back(Meshes::pack(vertex, box));
+			}
+			indices.insert(indices.end(), box_indices.begin(), box_indices.end());
+			mesh_names.emplace_back(materials[m % materials.size()].first + ".g" + std::to_string(m));
+			file.entries.emplace_back(mesh_names.back(), mesh);
+		}
+		file.packed_storage = std::move(packed);
+		file.packed = BlobSpan< Meshes::PackedVertex >(file.packed_storage);
+		file.index_storage = std::move(indices);
+		file.indices = BlobSpan< uint32_t >(file.index_storage);
+		file.compute_bounds();
+		file.write(meshes_out, compress);
+
+		//------ scene: the game's objects, then the generated chains ------
+		std::vector< AssetPackage::Object > scene;
+		{
+			MappedBlob base(from + "/scene.blob");
+			AssetPackage::read_scene(base, "str0", &scene);
+		}
+		uint32_t const chains = (objects + depth - 1) / depth;
+		uint32_t const clusters = std::max(1U, uint32_t(std::sqrt(float(chains)) / 4.0f));
+		uint32_t const side = uint32_t(std::ceil(std::sqrt(float(chains))));
+		std::vector< glm::vec2 > centers;
+		for (uint32_t c = 0; c < clusters; ++c) {
+			centers.emplace_back(random(-0.5f, 0.5f) * extent, random(-0.5f, 0.5f) * extent);
+		}
+		std::normal_distribution< float > spread(0.0f, 0.25f * extent / std::sqrt(float(clusters)));
+
+		scene.reserve(scene.size() + objects);
+		for (uint32_t chain = 0, made = 0; made < objects; ++chain) {
+			glm::vec2 at;
+			if (layout == "grid") {
+				at = (glm::vec2(chain % side, chain / side) + 0.5f) * (extent / side) - 0.5f * extent;
+			} else if (layout == "clusters") {
+				at = centers[mt() % clusters] + glm::vec2(spread(mt), spread(mt));
+			} else {
+				at = glm::vec2(random(-0.5f, 0.5f), random(-0.5f, 0.5f)) * extent;
+			}
+			for (uint32_t level = 0; level < depth && made < objects; ++level, ++made) {
+				uint32_t m = made % mesh_count; //(neighbours draw different meshes)
+				Mesh const &mesh = file.entries[file.entries.size() - mesh_count + m].second;
+				AssetPackage::Object object;
+				object.name = mesh_names[m];
+				object.dimension = mesh.bounds_max - mesh.bounds_min;
+				if (level == 0) {
+					object.position = glm::vec3(at, 0.5f * object.dimension.z);
+				} else { //(stacked on top of, and a bit smaller than, the object before)
+					object.position = glm::vec3(0.0f, 0.0f, 1.0f);
+					object.scale = glm::vec3(0.9f);
+					object.parent = uint32_t(scene.size() - 1);
+				}
+				object.rotation = glm::angleAxis(random(0.0f, 6.2831853f), glm::vec3(0.0f, 0.0f, 1.0f));
+				scene.emplace_back(object);
+			}
+		}
+
+		std::vector< char > strings;
+		std::vector< AssetPackage::SceneEntry > entries;
+		std::vector< uint32_t > parents;
+		entries.reserve(scene.size());
+		parents.reserve(scene.size());
+		std::unordered_map< std::string, std::pair< uint32_t, uint32_t > > name_ranges; //(each name is stored once)
+		for (auto const &object : scene) {
+			AssetPackage::SceneEntry entry;
+			auto f = name_ranges.find(object.name);
+			if (f == name_ranges.end()) {
+				entry.name_begin = uint32_t(strings.size());
+				strings.insert(strings.end(), object.name.begin(), object.name.end());
+				entry.name_end = uint32_t(strings.size());
+				name_ranges.emplace(object.name, std::make_pair(entry.name_begin, entry.name_end));
+			} else {
+				entry.name_begin = f->second.first;
+				entry.name_end = f->second.second;
+			}
+			entry.position = object.position;
+			entry.rotation = object.rotation;
+			entry.scale = object.scale;
+			entry.dimension = object.dimension;
+			entries.emplace_back(entry);
+			parents.emplace_back(object.parent);
+		}
+		BlobWriter writer;
+		writer.add_chunk("str0", strings);
+		writer.add_chunk("scn0", entries);
+		writer.add_chunk("prn0", parents);
+		writer.write(scene_out);
+
+		std::cout << "Wrote " << file.entries.size() << " meshes (" << mesh_count << " generated; " << file.packed.size << " vertices, "
+			<< file.indices.size << " indices) to '" << meshes_out << "' and " << scene.size() << " objects (" << objects << " generated, in "
+			<< chains << " chains of up to " << depth << ", " << layout << ") to '" << scene_out << "'." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}